@@ -0,0 +1,5 @@
+// Shared by the vertex shaders, bound to the camera's uniform buffer.
+uniform Camera {
+   mat4 ViewMatrix;
+   mat4 ProjectionMatrix;
+};
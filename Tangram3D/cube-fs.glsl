@@ -1,11 +1,18 @@
-#version 330 core
+#version 460 core
 
 in vec3 exPosition;
 in vec2 exTexcoord;
 in vec3 exNormal;
+flat in uint exMaterial;
 
 out vec4 FragmentColor;
-uniform vec3 givenColor;
+
+#include "materials.glsl"
+
+// The shading is chosen by the program variant, defining one of
+// CONSTANT_COLOR, POSITION_COLOR, UV_COLOR, NORMAL_COLOR or DIFFUSE_COLOR.
+// NORMAL_COLOR is the default.
+
 vec3 constantColor(void) {
     return vec3(0.5);
 }
@@ -24,7 +31,8 @@ vec3 normalColor(void) {
     float intensity = max(dot(N, dir), 0.0); // Calculate the intensity based on the normal
     float minIntensity = 0.2; // Minimum intensity to avoid completely black faces
     intensity = mix(minIntensity, 1.0, intensity); // Adjust the intensity to ensure a minimum value
-    return givenColor * intensity; // Adjust the original color based on the intensity
+    vec3 baseColor = materials[exMaterial].Diffuse.rgb;
+    return baseColor * intensity; // Adjust the original color based on the intensity
 }
 
 vec3 diffuseColor(void) {
@@ -36,11 +44,16 @@ vec3 diffuseColor(void) {
 
 void main(void)
 {
-    vec3 color;
-    // color = constantColor();
-    // color = positionColor();
-    // color = uvColor();
-    color = normalColor();
-    // color = diffuseColor();
+#if defined(CONSTANT_COLOR)
+    vec3 color = constantColor();
+#elif defined(POSITION_COLOR)
+    vec3 color = positionColor();
+#elif defined(UV_COLOR)
+    vec3 color = uvColor();
+#elif defined(DIFFUSE_COLOR)
+    vec3 color = diffuseColor();
+#else
+    vec3 color = normalColor();
+#endif
     FragmentColor = vec4(color, 1.0);
 }
@@ -1,4 +1,4 @@
-#version 330 core
+#version 460 core
 
 in vec3 inPosition;
 in vec2 inTexcoord;
@@ -7,19 +7,19 @@ in vec3 inNormal;
 out vec3 exPosition;
 out vec2 exTexcoord;
 out vec3 exNormal;
+flat out uint exMaterial;
 
 uniform mat4 ModelMatrix;
 
-uniform Camera {
-   mat4 ViewMatrix;
-   mat4 ProjectionMatrix;
-};
+#include "camera.glsl"
 
 void main(void)
 {
 	exPosition = inPosition;
 	exTexcoord = inTexcoord;
 	exNormal = inNormal;
+	// The material index is passed by the draw as its base instance.
+	exMaterial = uint(gl_BaseInstance);
 
 	vec4 MCPosition = vec4(inPosition, 1.0);
 	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * MCPosition;
@@ -0,0 +1,11 @@
+// Mirrors mgl::MaterialData, indexed by the draw's material.
+struct Material {
+    vec4 Diffuse;  // rgb, opacity
+    vec4 Specular; // rgb, shininess
+    vec4 Ambient;
+    vec4 Emissive;
+};
+
+layout(std430) readonly buffer Materials {
+    Material materials[];
+};
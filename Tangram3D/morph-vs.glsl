@@ -0,0 +1,56 @@
+#version 460 core
+
+in vec3 inPosition;
+in vec2 inTexcoord;
+in vec3 inNormal;
+
+out vec3 exPosition;
+out vec2 exTexcoord;
+out vec3 exNormal;
+flat out uint exMaterial;
+
+uniform mat4 ModelMatrix;
+uniform uint MorphBase;
+uniform uint MorphWeightBase;
+
+#include "camera.glsl"
+
+// Per mesh, an offset per vertex followed by the deltas, five words each:
+// position, normal xy as halves, and the target with the normal z as a half.
+layout(std430) readonly buffer Morphs {
+    uint morphs[];
+};
+
+layout(std430) readonly buffer MorphWeights {
+    float morphWeights[];
+};
+
+void main(void)
+{
+	vec3 position = inPosition;
+	vec3 normal = inNormal;
+	// Only the targets that move this vertex are visited.
+	if (MorphBase != 0xFFFFFFFFu) {
+		uint vertex = MorphBase + uint(gl_VertexID);
+		uint end = morphs[vertex + 1u];
+		for (uint i = morphs[vertex]; i < end; i += 5u) {
+			uint packed = morphs[i + 4u];
+			float weight = morphWeights[MorphWeightBase + (packed & 0xFFFFu)];
+			if (weight != 0.0) {
+				position += weight * uintBitsToFloat(
+					uvec3(morphs[i], morphs[i + 1u], morphs[i + 2u]));
+				normal += weight * vec3(unpackHalf2x16(morphs[i + 3u]),
+				                        unpackHalf2x16(packed >> 16).x);
+			}
+		}
+	}
+
+	exPosition = position;
+	exTexcoord = inTexcoord;
+	exNormal = normalize(normal);
+	// The material index is passed by the draw as its base instance.
+	exMaterial = uint(gl_BaseInstance);
+
+	vec4 MCPosition = vec4(position, 1.0);
+	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * MCPosition;
+}
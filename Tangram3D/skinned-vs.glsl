@@ -0,0 +1,42 @@
+#version 460 core
+
+in vec3 inPosition;
+in vec2 inTexcoord;
+in vec3 inNormal;
+in uvec4 inBones;
+in vec4 inWeights;
+
+out vec3 exPosition;
+out vec2 exTexcoord;
+out vec3 exNormal;
+flat out uint exMaterial;
+
+uniform mat4 ModelMatrix;
+uniform uint PaletteBase;
+
+#include "camera.glsl"
+
+layout(std430) readonly buffer Palettes {
+    mat4 palettes[];
+};
+
+void main(void)
+{
+	// Weights sum to 1, or to 0 for vertices that are not skinned.
+	mat4 skin = mat4(1.0);
+	if (dot(inWeights, vec4(1.0)) > 0.0) {
+		skin = palettes[PaletteBase + inBones.x] * inWeights.x
+		     + palettes[PaletteBase + inBones.y] * inWeights.y
+		     + palettes[PaletteBase + inBones.z] * inWeights.z
+		     + palettes[PaletteBase + inBones.w] * inWeights.w;
+	}
+	vec4 MCPosition = skin * vec4(inPosition, 1.0);
+
+	exPosition = MCPosition.xyz;
+	exTexcoord = inTexcoord;
+	exNormal = mat3(skin) * inNormal;
+	// The material index is passed by the draw as its base instance.
+	exMaterial = uint(gl_BaseInstance);
+
+	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * MCPosition;
+}
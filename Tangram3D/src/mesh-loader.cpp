@@ -18,95 +18,12 @@
 
 ////////////////////////////////////////////////////////////////////////// MYAPP
 
-class Node {
-public:
-	mgl::Mesh* mesh;
-	mgl::ShaderProgram* shader;
-	glm::mat4 modelMatrix;
-	GLint modelMatrixId;
-	GLint colorId;
-	glm::vec3 color;
-
-	Node(mgl::Mesh* mesh, const glm::mat4& modelMatrix)
-		: mesh(mesh), shader(shader), modelMatrix(modelMatrix) {}
-
-	// Create and configure the shader
-	void createShaderProgram() {
-		shader = new mgl::ShaderProgram();
-		shader->addShader(GL_VERTEX_SHADER, "cube-vs.glsl");
-		shader->addShader(GL_FRAGMENT_SHADER, "cube-fs.glsl");
-
-		shader->addAttribute(mgl::POSITION_ATTRIBUTE, mgl::Mesh::POSITION);
-		shader->addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
-
-		shader->addAttribute(mgl::TEXCOORD_ATTRIBUTE, mgl::Mesh::TEXCOORD);
-
-		shader->addAttribute(mgl::TANGENT_ATTRIBUTE, mgl::Mesh::TANGENT);
-
-		shader->addUniform(mgl::MODEL_MATRIX);
-		shader->addUniform("givenColor");
-		shader->addUniformBlock(mgl::CAMERA_BLOCK, 0);
-		shader->create();
-
-		colorId = shader->Uniforms["givenColor"].index;
-		modelMatrixId = shader->Uniforms[mgl::MODEL_MATRIX].index;
-	}
-
-	// Transformations for the node
-	void translate(const glm::vec3& translation) {
-		modelMatrix = glm::translate(modelMatrix, translation);
-	}
-
-	void rotate(float angle, const glm::vec3& axis) {
-		modelMatrix = glm::rotate(modelMatrix, glm::radians(angle), axis);
-	}
-
-	void scale(const glm::vec3& scale) {
-		modelMatrix = glm::scale(modelMatrix, scale);
-	}
-
-	void resetModelMatrix() {
-		modelMatrix = glm::mat4(1.0f);
-	}
-
-	void setColor(const glm::vec3& color) {
-		this->color = color;
-	}
-};
-
-class SceneGraph {
-public:
-	std::vector<Node> nodes;
-
-	void addNode(const Node& node) {
-		nodes.push_back(node);
-	}
-
-	void draw() {
-		for (const auto& node : nodes) {
-			node.shader->bind();
-			glUniform3fv(node.colorId, 1, glm::value_ptr(node.color));
-			glUniformMatrix4fv(node.modelMatrixId, 1, GL_FALSE, glm::value_ptr(node.modelMatrix));
-			node.mesh->draw();
-			node.shader->unbind();
-		}
-	}
-
-	void createShaderPrograms() {
-		for (auto& node : nodes) {
-			node.createShaderProgram();
-		}
-	}
-	void resetNodesTransformations() {
-		for (auto& node : nodes) {
-			node.resetModelMatrix();
-		}
-	}
-
-	void setNodeColor(int index ,const glm::vec3& color) {
-		this->nodes[index].setColor(color);
-	}
-
+// A piece pose kept as translation, rotation and scale so that the
+// figure<->box transition can interpolate it without decomposing matrices.
+struct Pose {
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
 };
 
 class MyApp : public mgl::App {
@@ -121,18 +38,27 @@ class MyApp : public mgl::App {
 
  private:
   const GLuint UBO_BP = 0;
-  mgl::ShaderProgram *Shaders = nullptr;
+  const GLuint SSBO_BP = 0;
+  mgl::ResourceManager::ProgramHandle Shaders;
+  // Per shading mode, its program variant and scene graph material, made
+  // the first time the mode is selected.
+  std::vector<mgl::ResourceManager::ProgramHandle> ShadingPrograms;
+  std::vector<unsigned int> ShadingMaterials;
+  unsigned int ShadingMode = 0;
   mgl::Camera *Camera = nullptr;
-  GLint ModelMatrixId;
-  mgl::Mesh* SquareMesh = nullptr;
-  mgl::Mesh* TriangleMesh = nullptr;
-  mgl::Mesh* ParallelogramMesh = nullptr;
-  SceneGraph sceneGraph;
+  mgl::MaterialBuffer *Materials = nullptr;
+  mgl::ResourceManager::MeshHandle SquareMesh;
+  mgl::ResourceManager::MeshHandle TriangleMesh;
+  mgl::ResourceManager::MeshHandle ParallelogramMesh;
+  mgl::SceneGraph sceneGraph;
+  unsigned int figureRoot;
+  std::vector<unsigned int> pieces;
   bool rotatingView = false;
   double mouse_x, mouse_y;
 
   void createMeshes();
   void createShaderPrograms();
+  void setShading(unsigned int mode);
   void createCamera();
   void drawScene();
   void rotateCamera(float angleX, float angleY);
@@ -143,8 +69,7 @@ class MyApp : public mgl::App {
   float animationSpeed = 0.5f;    
   bool isLeftKeyPressed = false;
   bool isRightKeyPressed = false;
-  glm::mat4 startMatrix;
-  glm::mat4 endMatrix;
+  float appliedProgress = -1.0f;
   float previousTime = 0.0f;
 };
 
@@ -152,60 +77,104 @@ class MyApp : public mgl::App {
 
 void MyApp::createMeshes() {
   std::string mesh_dir = "assets/";
-  std::string mesh_file = "square.obj";
-  std::string mesh_file2 = "parallelogram.obj";
-  std::string mesh_file3 = "triangle.obj";
-
-  std::string mesh_fullname = mesh_dir + mesh_file;
-
-  // Load square mesh
-  SquareMesh = new mgl::Mesh();
-  SquareMesh->joinIdenticalVertices();
-  SquareMesh->create(mesh_fullname);
-  sceneGraph.addNode(Node(SquareMesh, glm::mat4(1.0f)));
-  sceneGraph.setNodeColor(0, glm::vec3(0.0f, 0.6f, 0.0f)); //square color (green)	
-
-  mesh_fullname = mesh_dir + mesh_file2;
-
-  // Load parallelogram mesh
-  ParallelogramMesh = new mgl::Mesh();
-  ParallelogramMesh->joinIdenticalVertices();
-  ParallelogramMesh->create(mesh_fullname);
-  sceneGraph.addNode(Node(ParallelogramMesh, glm::mat4(1.0f)));
-  sceneGraph.setNodeColor(1, glm::vec3(1.0f, 0.647f, 0.0f)); //paralelogram color (orange)
-  
-
-  mesh_fullname = mesh_dir + mesh_file3;
-  
-  // Load triangle mesh and add several nodes of the same mesh with different colors
-  TriangleMesh = new mgl::Mesh();
-  TriangleMesh->joinIdenticalVertices();
-  TriangleMesh->create(mesh_fullname);
-
-  for (uint16_t i = 0; i < 5; i++) {
-	sceneGraph.addNode(Node(TriangleMesh, glm::mat4(1.0f)));
-	if (i == 0) {
-		sceneGraph.setNodeColor(i + 2, glm::vec3(0.376f, 0.482f, 0.745f)); //small triangle 1 color (greyed-blue)
-	}
-	else if (i == 1) {
-		sceneGraph.setNodeColor(i + 2, glm::vec3(1.000, 0.271, 0.0)); //small triangle 2 color (orange-red)
-	}
-	else if (i == 2) {
-		sceneGraph.setNodeColor(i + 2, glm::vec3(0.502f, 0.0f, 0.502f)); //mid-size triangle color (purple)
-	}
-	else if (i == 3) {
-		sceneGraph.setNodeColor(i + 2, glm::vec3(0.275f, 0.460f, 0.806f)); //big triangle 1 color (blue)
-	}
-	else if (i == 4) {
-		sceneGraph.setNodeColor(i + 2, glm::vec3(0.780f, 0.082f, 0.522f)); //big triangle 2 color (pink-red)
+  // A pack made with "mgl-bake --pack assets.mglp assets <dir>" replaces the
+  // loose files with a single mapping and meshes that need no processing.
+  const bool packed =
+      mgl::AssetPacks::getInstance().mount("assets.mglp", mesh_dir);
+  std::string mesh_ext = packed ? mgl::BAKED_EXTENSION : ".obj";
+  std::string mesh_file = "square" + mesh_ext;
+  std::string mesh_file2 = "parallelogram" + mesh_ext;
+  std::string mesh_file3 = "triangle" + mesh_ext;
+
+  const unsigned int flags =
+      aiProcess_Triangulate | aiProcess_JoinIdenticalVertices;
+
+  // Meshes are parsed on worker threads and uploaded by the engine between
+  // frames; pieces appear as soon as their mesh is ready.
+  mgl::ResourceManager &resources = mgl::ResourceManager::getInstance();
+  SquareMesh = resources.acquireMesh(mesh_dir + mesh_file, flags);
+  ParallelogramMesh = resources.acquireMesh(mesh_dir + mesh_file2, flags);
+  // Shared by the five triangle pieces
+  TriangleMesh = resources.acquireMesh(mesh_dir + mesh_file3, flags);
+  // Nothing reads the vertices back once they are on the GPU.
+  SquareMesh->setRetention(mgl::Mesh::KEEP_NONE);
+  ParallelogramMesh->setRetention(mgl::Mesh::KEEP_NONE);
+  TriangleMesh->setRetention(mgl::Mesh::KEEP_NONE);
+
+  const unsigned int square = sceneGraph.addMesh(SquareMesh.get());
+  const unsigned int parallelogram =
+      sceneGraph.addMesh(ParallelogramMesh.get());
+  const unsigned int triangle = sceneGraph.addMesh(TriangleMesh.get());
+
+  // Every piece is a child of the figure root, so moving the whole figure only
+  // touches the root and the world matrices below it.
+  figureRoot = sceneGraph.addNode();
+
+  // The square and the parallelogram are drawn with the materials of their
+  // MTL files. The triangle mesh is shared, so each triangle piece is drawn
+  // with its own entry of the material table instead.
+  Materials = new mgl::MaterialBuffer(SSBO_BP);
+  sceneGraph.setMaterialBuffer(Materials);
+
+  const unsigned int meshes[] = {square, parallelogram, triangle, triangle,
+                                 triangle, triangle, triangle};
+  const glm::vec3 colors[] = {
+	  glm::vec3(0.376f, 0.482f, 0.745f),  // small triangle 1 (greyed-blue)
+	  glm::vec3(1.000f, 0.271f, 0.0f),    // small triangle 2 (orange-red)
+	  glm::vec3(0.502f, 0.0f, 0.502f),    // mid-size triangle (purple)
+	  glm::vec3(0.275f, 0.460f, 0.806f),  // big triangle 1 (blue)
+	  glm::vec3(0.780f, 0.082f, 0.522f)   // big triangle 2 (pink-red)
+  };
+  for (unsigned int i = 0; i < 7; i++) {
+	const unsigned int piece = sceneGraph.addNode(figureRoot);
+	sceneGraph.setMesh(piece, meshes[i]);
+	if (meshes[i] == triangle) {
+		mgl::MaterialData material;
+		material.Diffuse = glm::vec4(colors[i - 2], 1.0f);
+		sceneGraph.setMaterialBase(piece, Materials->add(material));
 	}
+	pieces.push_back(piece);
   }
 }
 
 ///////////////////////////////////////////////////////////////////////// SHADER
 
+// The shading modes of cube-fs.glsl, each compiled as its own variant.
+const char *const SHADING_MODES[] = {"NORMAL_COLOR", "CONSTANT_COLOR",
+                                     "POSITION_COLOR", "UV_COLOR",
+                                     "DIFFUSE_COLOR"};
+const unsigned int SHADING_MODE_COUNT = 5;
+
 void MyApp::createShaderPrograms() {
-	sceneGraph.createShaderPrograms();
+	ShadingPrograms.resize(SHADING_MODE_COUNT);
+	ShadingMaterials.resize(SHADING_MODE_COUNT);
+	setShading(0);
+}
+
+// All pieces share one program; they only differ by mesh and material.
+// Switching back to a mode reuses its compiled variant.
+void MyApp::setShading(unsigned int mode) {
+	if (!ShadingPrograms[mode]) {
+		ShadingPrograms[mode] = mgl::ResourceManager::getInstance().acquireProgram(
+			"tangram", {{SHADING_MODES[mode], ""}},
+			[this](mgl::ShaderProgram &program) {
+				program.addShader(GL_VERTEX_SHADER, "cube-vs.glsl");
+				program.addShader(GL_FRAGMENT_SHADER, "cube-fs.glsl");
+
+				mgl::TangentSpaceVertex::bindAttributes(program);
+
+				program.addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
+				program.addStorageBlock(mgl::MATERIAL_BLOCK, SSBO_BP);
+				program.create();
+			});
+		ShadingMaterials[mode] =
+			sceneGraph.addMaterial(ShadingPrograms[mode].get());
+	}
+	Shaders = ShadingPrograms[mode];
+	ShadingMode = mode;
+	for (unsigned int piece : pieces) {
+		sceneGraph.setMaterial(piece, ShadingMaterials[mode]);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////// CAMERA
@@ -335,35 +304,35 @@ glm::mat4 CurrentViewMatrix2 = ViewMatrix2;
 int CurrentCam = 1;
 glm::mat4 CurrentProjectionMatrix1 = ProjectionMatrix1;
 glm::mat4 CurrentProjectionMatrix2 = ProjectionMatrix2;
-std::vector<glm::mat4> CurrentModelMatrix;
+std::vector<Pose> figurePoses;
+std::vector<Pose> boxPoses;
 
 void MyApp::createCamera() {
   Camera = new mgl::Camera(UBO_BP);
   Camera->setViewMatrix(ViewMatrix1);
   Camera->setProjectionMatrix(CurrentProjectionMatrix2);
+  sceneGraph.setCamera(Camera);
 }
 
 /////////////////////////////////////////////////////////////////////////// DRAW
 
 
-// Helper function to interpolate between two models
-
-glm::mat4 interpolateMatrices(const glm::mat4& start, const glm::mat4& end, float t) {
-	glm::vec3 startTranslation, startScale, startSkew;
-	glm::quat startRotation;
-	glm::vec4 startPerspective;
-	glm::decompose(start, startScale, startRotation, startTranslation, startSkew, startPerspective);
+// Helpers to decompose a model matrix into a pose and interpolate two poses
 
-	glm::vec3 endTranslation, endScale, endSkew;
-	glm::quat endRotation;
-	glm::vec4 endPerspective;
-	glm::decompose(end, endScale, endRotation, endTranslation, endSkew, endPerspective);
-
-	glm::vec3 interpTranslation = glm::mix(startTranslation, endTranslation, t);
-	glm::vec3 interpScale = glm::mix(startScale, endScale, t);
-	glm::quat interpRotation = glm::slerp(startRotation, endRotation, t);
+Pose decomposeMatrix(const glm::mat4& matrix) {
+	Pose pose;
+	glm::vec3 skew;
+	glm::vec4 perspective;
+	glm::decompose(matrix, pose.scale, pose.rotation, pose.translation, skew, perspective);
+	return pose;
+}
 
-	return glm::translate(interpTranslation) * glm::mat4_cast(interpRotation) * glm::scale(interpScale);
+Pose interpolatePoses(const Pose& start, const Pose& end, float t) {
+	Pose pose;
+	pose.translation = glm::mix(start.translation, end.translation, t);
+	pose.rotation = glm::slerp(start.rotation, end.rotation, t);
+	pose.scale = glm::mix(start.scale, end.scale, t);
+	return pose;
 }
 
 
@@ -393,25 +362,16 @@ void MyApp::drawScene() {
 		}
 	}
 	
-	// Interpolate model matrices based on animationProgress
-	for (size_t i = 0; i < figureModelMatrices.size(); i++) {
-		if (isLeftKeyPressed || animationProgress == 0.0f) {
-			startMatrix = figureModelMatrices[i];
-			endMatrix = boxModelMatrices[i];
-			sceneGraph.nodes[i].modelMatrix = interpolateMatrices(startMatrix, endMatrix, animationProgress);
+	// Poses only depend on the animation progress, so pieces are only marked
+	// dirty (and their world matrices recomputed) while the progress changes.
+	if (animationProgress != appliedProgress) {
+		for (size_t i = 0; i < pieces.size(); i++) {
+			const Pose pose = interpolatePoses(figurePoses[i], boxPoses[i], animationProgress);
+			sceneGraph.setTransform(pieces[i], pose.translation, pose.rotation, pose.scale);
 		}
-		else if (isRightKeyPressed || animationProgress == 1.0f) {
-			startMatrix = boxModelMatrices[i];
-			endMatrix = figureModelMatrices[i];
-			sceneGraph.nodes[i].modelMatrix = interpolateMatrices(startMatrix, endMatrix, 1 - animationProgress);
-		}
-		else {
-			sceneGraph.nodes[i].modelMatrix = CurrentModelMatrix[i];
-		}
-		CurrentModelMatrix[i] = sceneGraph.nodes[i].modelMatrix;
+		appliedProgress = animationProgress;
 	}
 	sceneGraph.draw();
-	sceneGraph.resetNodesTransformations();
 }
 
 ////////////////////////////////////////////////////////////////////// CALLBACKS
@@ -421,7 +381,10 @@ void MyApp::initCallback(GLFWwindow *win) {
 	createShaderPrograms();
 	createCamera();
 
-	CurrentModelMatrix.resize(figureModelMatrices.size(), glm::mat4(1.0f));
+	for (size_t i = 0; i < figureModelMatrices.size(); i++) {
+		figurePoses.push_back(decomposeMatrix(figureModelMatrices[i]));
+		boxPoses.push_back(decomposeMatrix(boxModelMatrices[i]));
+	}
 
 	previousTime = glfwGetTime();
 }
@@ -464,6 +427,10 @@ void MyApp::keyCallback(GLFWwindow* win, int key, int scancode, int action, int
 			}
 			break;
 
+		case GLFW_KEY_M: // Switch shading mode
+			setShading((ShadingMode + 1) % SHADING_MODE_COUNT);
+			break;
+
 		case GLFW_KEY_C: // Switch camera (view)
 			if (CurrentCam == 1) {
 				Camera->setViewMatrix(CurrentViewMatrix2);
@@ -591,6 +558,7 @@ int main(int argc, char *argv[]) {
   engine.setApp(new MyApp());
   engine.setOpenGL(4, 6);
   engine.setWindow(800, 600, "Tangram 3D Group 11", 0, 1);
+  engine.setUploader(1);
   engine.init();
   engine.run();
   exit(EXIT_SUCCESS);
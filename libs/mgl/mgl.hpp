@@ -13,11 +13,25 @@
 #include <GLFW/glfw3.h>
 
 #include "./mglApp.hpp"          // IWYU pragma: keep
+#include "./mglBaked.hpp"        // IWYU pragma: keep
 #include "./mglCamera.hpp"       // IWYU pragma: keep
 #include "./mglConventions.hpp"  // IWYU pragma: keep
+#include "./mglDeletionQueue.hpp" // IWYU pragma: keep
 #include "./mglError.hpp"        // IWYU pragma: keep
+#include "./mglLoader.hpp"       // IWYU pragma: keep
+#include "./mglMaterials.hpp"    // IWYU pragma: keep
 #include "./mglMesh.hpp"         // IWYU pragma: keep
+#include "./mglRenderQueue.hpp"  // IWYU pragma: keep
+#include "./mglResources.hpp"    // IWYU pragma: keep
+#include "./mglRing.hpp"         // IWYU pragma: keep
 #include "./mglScenegraph.hpp"   // IWYU pragma: keep
 #include "./mglShader.hpp"       // IWYU pragma: keep
+#include "./mglMorph.hpp"        // IWYU pragma: keep
+#include "./mglOptimize.hpp"     // IWYU pragma: keep
+#include "./mglPack.hpp"         // IWYU pragma: keep
+#include "./mglSkeleton.hpp"     // IWYU pragma: keep
+#include "./mglSkinning.hpp"     // IWYU pragma: keep
+#include "./mglState.hpp"        // IWYU pragma: keep
+#include "./mglVertexFormat.hpp" // IWYU pragma: keep
 
 #endif /* MGL_HPP */
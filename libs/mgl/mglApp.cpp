@@ -11,6 +11,11 @@
 #include <iostream>
 
 #include "./mglError.hpp" // IWYU pragma: keep -- required in debug mode
+#include "./mglDeletionQueue.hpp"
+#include "./mglLoader.hpp"
+#include "./mglResources.hpp"
+#include "./mglRing.hpp"
+#include "./mglState.hpp"
 
 namespace mgl {
 
@@ -58,9 +63,13 @@ static void joystick_callback(int jid, int event) {
 Engine::Engine(void) {
   GlApp = 0;
   Window = 0;
+  UploadContext = 0;
   WindowWidth = 640, WindowHeight = 480;
   GlMajor = 3, GlMinor = 3;
   Fullscreen = 0, Vsync = 0;
+  Uploader = 0;
+  RingSize = 8 << 20;
+  Ring = 0;
   WindowTitle = "OpenGL App GLFW Window 2024(c) Carlos Martinho";
 }
 
@@ -89,6 +98,22 @@ void Engine::setWindow(int width, int height, const char *title, int fullscreen,
   Vsync = vsync;
 }
 
+// With an uploader, mesh buffers are created and filled on a thread with its
+// own context, shared with the window's, so large uploads do not stall frames.
+void Engine::setUploader(int uploader) { Uploader = uploader; }
+
+// Data written every frame, such as skinning palettes and morph weights, is
+// streamed through a single ring, created on first use, which needs OpenGL
+// 4.4. Its regions are reused once the frame that wrote them has completed.
+void Engine::setUploadRing(GLsizeiptr size) { RingSize = size; }
+
+UploadRing &Engine::getUploadRing() {
+  if (!Ring) {
+    Ring = new UploadRing(RingSize);
+  }
+  return *Ring;
+}
+
 /////////////////////////////////////////////////////////////////////////// INIT
 
 void Engine::setupWindow() {
@@ -102,6 +127,16 @@ void Engine::setupWindow() {
   glfwSwapInterval(Vsync);
 }
 
+void Engine::setupUploader() {
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  UploadContext = glfwCreateWindow(1, 1, WindowTitle, 0, Window);
+  if (!UploadContext) {
+    glfwTerminate();
+    exit(EXIT_FAILURE);
+  }
+  glfwDefaultWindowHints();
+}
+
 void Engine::setupCallbacks() {
   glfwSetCursorPosCallback(Window, cursor_pos_callback);
   glfwSetKeyCallback(Window, key_callback);
@@ -123,6 +158,9 @@ void Engine::setupGLFW() {
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 #endif
   setupWindow();
+  if (Uploader) {
+    setupUploader();
+  }
   setupCallbacks();
 }
 
@@ -141,13 +179,14 @@ void Engine::setupGLEW() {
 }
 
 void Engine::setupOpenGL() {
+  StateCache &state = StateCache::getInstance();
   glClearColor(0.1f, 0.1f, 0.3f, 1.0f);
-  glEnable(GL_DEPTH_TEST);
+  state.enable(GL_DEPTH_TEST);
   glDepthFunc(GL_LEQUAL);
   glDepthMask(GL_TRUE);
   glDepthRange(0.0, 1.0);
   glClearDepth(1.0);
-  glEnable(GL_CULL_FACE);
+  state.enable(GL_CULL_FACE);
   glCullFace(GL_BACK);
   glFrontFace(GL_CCW);
   glViewport(0, 0, WindowWidth, WindowHeight);
@@ -168,6 +207,9 @@ void Engine::init() {
   setupGLFW();
   setupGLEW();
   setupOpenGL();
+  if (UploadContext) {
+    MeshLoader::getInstance().startUploader(UploadContext);
+  }
   GlApp->initCallback(Window);
 #ifdef DEBUG
   displayInfo();
@@ -183,11 +225,25 @@ void Engine::run() {
     double time = glfwGetTime();
     double elapsed_time = time - last_time;
     last_time = time;
+    MeshLoader::getInstance().upload();
+    ResourceManager::getInstance().collect();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     GlApp->displayCallback(Window, elapsed_time);
+    if (Ring) {
+      Ring->endFrame();
+    }
+    DeletionQueue::getInstance().endFrame();
     glfwSwapBuffers(Window);
     glfwPollEvents();
   }
+  MeshLoader::getInstance().shutdown();
+  ResourceManager::getInstance().evictUnreferenced();
+  delete Ring;
+  Ring = 0;
+  DeletionQueue::getInstance().flush();
+  if (UploadContext) {
+    glfwDestroyWindow(UploadContext);
+  }
   glfwDestroyWindow(Window);
   glfwTerminate();
 }
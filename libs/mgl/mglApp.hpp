@@ -18,6 +18,7 @@ namespace mgl {
 
 class App;
 class Engine;
+class UploadRing;
 
 //////////////////////////////////////////////////////////////////////////// App
 
@@ -50,6 +51,9 @@ public:
   void setOpenGL(int major, int minor);
   void setWindow(int width, int height, const char *title, int fullscreen,
                  int vsync);
+  void setUploader(int uploader);
+  void setUploadRing(GLsizeiptr size);
+  UploadRing &getUploadRing();
   void init();
   void run();
 
@@ -64,8 +68,13 @@ private:
   const char *WindowTitle;
   int Fullscreen;
   int Vsync;
+  int Uploader;
+  GLFWwindow *UploadContext;
+  GLsizeiptr RingSize;
+  UploadRing *Ring;
 
   void setupWindow();
+  void setupUploader();
   void setupGLFW();
   void setupGLEW();
   void setupOpenGL();
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Baked Asset Files
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglBaked.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace mgl {
+
+/////////////////////////////////////////////////////////////////// BAKED FORMAT
+
+bool isBakedFile(const std::string &filename) {
+  const std::size_t n = sizeof(BAKED_EXTENSION) - 1;
+  return filename.size() >= n &&
+         filename.compare(filename.size() - n, n, BAKED_EXTENSION) == 0;
+}
+
+//////////////////////////////////////////////////////////////////// BakedWriter
+
+BakedWriter::BakedWriter(const std::string &filename)
+    : Filename(filename), Out(filename, std::ios::binary), Size(0) {
+  if (!Out) {
+    std::cerr << "[ERROR] Cannot write " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  writeBytes(BAKED_MAGIC, sizeof(BAKED_MAGIC));
+  write(BAKED_VERSION);
+}
+
+void BakedWriter::write(const std::string &value) {
+  write(static_cast<uint32_t>(value.size()));
+  writeBytes(value.data(), value.size());
+}
+
+void BakedWriter::writeBytes(const void *data, std::size_t size) {
+  if (size > 0) {
+    Out.write(static_cast<const char *>(data),
+              static_cast<std::streamsize>(size));
+    Size += size;
+  }
+}
+
+std::size_t BakedWriter::size() const { return Size; }
+
+void BakedWriter::close() {
+  Out.close();
+  if (Out.fail()) {
+    std::cerr << "[ERROR] Failed to write " << Filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+//////////////////////////////////////////////////////////////////// BakedReader
+
+BakedReader::BakedReader(const std::string &filename)
+    : Filename(filename), Offset(0) {
+  if (!File.open(filename)) {
+    throw LoadError("Cannot open " + filename);
+  }
+  char magic[sizeof(BAKED_MAGIC)];
+  uint32_t version;
+  readBytes(magic, sizeof(magic));
+  read(version);
+  if (std::memcmp(magic, BAKED_MAGIC, sizeof(magic)) != 0 ||
+      version != BAKED_VERSION) {
+    throw LoadError(filename + " is not a baked file of version " +
+                    std::to_string(BAKED_VERSION));
+  }
+}
+
+void BakedReader::read(std::string &value) {
+  uint32_t size;
+  read(size);
+  value.resize(size);
+  readBytes(&value[0], size);
+}
+
+void BakedReader::readBytes(void *data, std::size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (size > File.size() - Offset) {
+    throw LoadError(Filename + " is truncated");
+  }
+  std::memcpy(data, File.data() + Offset, size);
+  Offset += size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
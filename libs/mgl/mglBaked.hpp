@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Baked Asset Files
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_BAKED_HPP
+#define MGL_BAKED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "./mglPack.hpp"
+
+namespace mgl {
+
+class BakedWriter;
+class BakedReader;
+
+/////////////////////////////////////////////////////////////////// BAKED FORMAT
+//
+// Baked files hold data already in its runtime form, written by mgl-bake and
+// read back with no other processing than copying it out of a mapped file or
+// asset pack.
+// A file starts with BAKED_MAGIC and BAKED_VERSION, followed by what its
+// owner writes: trivially copyable values as their bytes, vectors as a 32-bit
+// count and their elements, and strings as a vector of chars. Bytes are in
+// the order of the machine that baked them.
+
+const char BAKED_MAGIC[4] = {'M', 'G', 'L', 'B'};
+const uint32_t BAKED_VERSION = 1;
+const char BAKED_EXTENSION[] = ".mglb";
+
+bool isBakedFile(const std::string &filename);
+
+//////////////////////////////////////////////////////////////////// BakedWriter
+
+class BakedWriter {
+ public:
+  explicit BakedWriter(const std::string &filename);
+  BakedWriter(const BakedWriter &) = delete;
+  BakedWriter &operator=(const BakedWriter &) = delete;
+
+  template <typename T> void write(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "values are written as their bytes");
+    writeBytes(&value, sizeof(T));
+  }
+  template <typename T> void write(const std::vector<T> &values) {
+    write(static_cast<uint32_t>(values.size()));
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      writeBytes(values.data(), sizeof(T) * values.size());
+    } else {
+      for (const T &value : values) {
+        write(value);
+      }
+    }
+  }
+  void write(const std::string &value);
+  void writeBytes(const void *data, std::size_t size);
+  std::size_t size() const;
+  // Exits if anything failed to be written.
+  void close();
+
+ private:
+  std::string Filename;
+  std::ofstream Out;
+  std::size_t Size;
+};
+
+//////////////////////////////////////////////////////////////////// BakedReader
+
+// Throws LoadError if the file is missing, of another version or truncated.
+class BakedReader {
+ public:
+  explicit BakedReader(const std::string &filename);
+  BakedReader(const BakedReader &) = delete;
+  BakedReader &operator=(const BakedReader &) = delete;
+
+  template <typename T> void read(T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "values are read as their bytes");
+    readBytes(&value, sizeof(T));
+  }
+  template <typename T> void read(std::vector<T> &values) {
+    uint32_t count;
+    read(count);
+    values.resize(count);
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      readBytes(values.data(), sizeof(T) * count);
+    } else {
+      for (T &value : values) {
+        read(value);
+      }
+    }
+  }
+  void read(std::string &value);
+  void readBytes(void *data, std::size_t size);
+
+ private:
+  std::string Filename;
+  AssetFile File;
+  std::size_t Offset;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_BAKED_HPP */
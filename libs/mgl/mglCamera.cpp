@@ -10,42 +10,74 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include "./mglDeletionQueue.hpp"
+#include "./mglState.hpp"
+
 namespace mgl {
 
 ///////////////////////////////////////////////////////////////////////// Camera
 
 Camera::Camera(GLuint bindingpoint)
     : ViewMatrix(glm::mat4(1.0f)), ProjectionMatrix(glm::mat4(1.0f)) {
-  glGenBuffers(1, &UboId);
-  glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-  glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * 2, 0, GL_STREAM_DRAW);
-  glBindBufferBase(GL_UNIFORM_BUFFER, bindingpoint, UboId);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  StateCache &state = StateCache::getInstance();
+  DirectStateAccess = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+  if (DirectStateAccess) {
+    glCreateBuffers(1, &UboId);
+    glNamedBufferStorage(UboId, sizeof(glm::mat4) * 2, 0,
+                         GL_DYNAMIC_STORAGE_BIT);
+  } else {
+    glGenBuffers(1, &UboId);
+    state.bindBuffer(GL_UNIFORM_BUFFER, UboId);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * 2, 0, GL_STREAM_DRAW);
+  }
+  state.bindBufferBase(GL_UNIFORM_BUFFER, bindingpoint, UboId);
+  updateFrustumPlanes();
 }
 
-Camera::~Camera() {
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
-  glDeleteBuffers(1, &UboId);
-}
+Camera::~Camera() { DeletionQueue::getInstance().deleteBuffer(UboId); }
 
 glm::mat4 Camera::getViewMatrix() const { return ViewMatrix; }
 
 void Camera::setViewMatrix(const glm::mat4 &viewmatrix) {
   ViewMatrix = viewmatrix;
-  glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-                  glm::value_ptr(ViewMatrix));
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  updateBuffer(0, ViewMatrix);
+  updateFrustumPlanes();
 }
 
 glm::mat4 Camera::getProjectionMatrix() const { return ProjectionMatrix; }
 
 void Camera::setProjectionMatrix(const glm::mat4 &projectionmatrix) {
   ProjectionMatrix = projectionmatrix;
-  glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-                  glm::value_ptr(ProjectionMatrix));
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  updateBuffer(sizeof(glm::mat4), ProjectionMatrix);
+  updateFrustumPlanes();
+}
+
+void Camera::updateBuffer(GLintptr offset, const glm::mat4 &matrix) {
+  if (DirectStateAccess) {
+    glNamedBufferSubData(UboId, offset, sizeof(glm::mat4),
+                         glm::value_ptr(matrix));
+  } else {
+    StateCache::getInstance().bindBuffer(GL_UNIFORM_BUFFER, UboId);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(glm::mat4),
+                    glm::value_ptr(matrix));
+  }
+}
+
+const glm::vec4 *Camera::getFrustumPlanes() const { return FrustumPlanes; }
+
+void Camera::updateFrustumPlanes() {
+  // Gribb-Hartmann: each plane is a sum or difference of the rows of the
+  // combined view-projection matrix (GLM matrices are column-major).
+  const glm::mat4 m = glm::transpose(ProjectionMatrix * ViewMatrix);
+  FrustumPlanes[0] = m[3] + m[0];
+  FrustumPlanes[1] = m[3] - m[0];
+  FrustumPlanes[2] = m[3] + m[1];
+  FrustumPlanes[3] = m[3] - m[1];
+  FrustumPlanes[4] = m[3] + m[2];
+  FrustumPlanes[5] = m[3] - m[2];
+  for (glm::vec4 &plane : FrustumPlanes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -22,8 +22,13 @@ class Camera;
 class Camera {
  private:
   GLuint UboId;
+  bool DirectStateAccess;
   glm::mat4 ViewMatrix;
   glm::mat4 ProjectionMatrix;
+  glm::vec4 FrustumPlanes[6];
+
+  void updateBuffer(GLintptr offset, const glm::mat4 &matrix);
+  void updateFrustumPlanes();
 
  public:
   explicit Camera(GLuint bindingpoint);
@@ -32,6 +37,9 @@ class Camera {
   void setViewMatrix(const glm::mat4 &viewmatrix);
   glm::mat4 getProjectionMatrix() const;
   void setProjectionMatrix(const glm::mat4 &projectionmatrix);
+  // Left, right, bottom, top, near and far planes in world space, as
+  // (normal, distance) with normals pointing inwards.
+  const glm::vec4 *getFrustumPlanes() const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
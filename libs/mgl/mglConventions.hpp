@@ -19,6 +19,13 @@ const char VIEW_MATRIX[] = "ViewMatrix";
 const char PROJECTION_MATRIX[] = "ProjectionMatrix";
 const char TEXTURE_MATRIX[] = "TextureMatrix";
 const char CAMERA_BLOCK[] = "Camera";
+const char MATERIAL_BLOCK[] = "Materials";
+const char PALETTE_BLOCK[] = "Palettes";
+const char PALETTE_BASE[] = "PaletteBase";
+const char MORPH_BLOCK[] = "Morphs";
+const char MORPH_WEIGHT_BLOCK[] = "MorphWeights";
+const char MORPH_BASE[] = "MorphBase";
+const char MORPH_WEIGHT_BASE[] = "MorphWeightBase";
 
 const char POSITION_ATTRIBUTE[] = "inPosition";
 const char NORMAL_ATTRIBUTE[] = "inNormal";
@@ -26,6 +33,8 @@ const char TEXCOORD_ATTRIBUTE[] = "inTexcoord";
 const char TANGENT_ATTRIBUTE[] = "inTangent";
 const char BITANGENT_ATTRIBUTE[] = "inBitangent";
 const char COLOR_ATTRIBUTE[] = "inColor";
+const char BONES_ATTRIBUTE[] = "inBones";
+const char WEIGHTS_ATTRIBUTE[] = "inWeights";
 
 ////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
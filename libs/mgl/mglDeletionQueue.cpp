@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Deferred GL Object Deletion
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglDeletionQueue.hpp"
+
+#include "./mglState.hpp"
+
+namespace mgl {
+
+////////////////////////////////////////////////////////////////// DeletionQueue
+
+DeletionQueue &DeletionQueue::getInstance() {
+  static DeletionQueue instance;
+  return instance;
+}
+
+void DeletionQueue::deleteBuffer(GLuint buffer) {
+  Pending.push_back({BUFFER, buffer});
+}
+
+void DeletionQueue::deleteVertexArray(GLuint vao) {
+  Pending.push_back({VERTEX_ARRAY, vao});
+}
+
+void DeletionQueue::deleteProgram(GLuint program) {
+  Pending.push_back({PROGRAM, program});
+}
+
+// Deletion goes through the state cache, so that cached bindings of the
+// deleted objects are forgotten.
+void DeletionQueue::release(const std::vector<Object> &objects) {
+  StateCache &state = StateCache::getInstance();
+  for (const Object &object : objects) {
+    switch (object.kind) {
+    case BUFFER:
+      state.deleteBuffer(object.name);
+      break;
+    case VERTEX_ARRAY:
+      state.deleteVertexArray(object.name);
+      break;
+    case PROGRAM:
+      state.deleteProgram(object.name);
+      break;
+    }
+  }
+}
+
+// Fences are polled, never waited for.
+void DeletionQueue::endFrame() {
+  if (!Pending.empty()) {
+    Fenced.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), {}});
+    Fenced.back().objects.swap(Pending);
+  }
+  while (!Fenced.empty()) {
+    const GLenum status = glClientWaitSync(Fenced.front().fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    glDeleteSync(Fenced.front().fence);
+    release(Fenced.front().objects);
+    Fenced.pop_front();
+  }
+}
+
+// Deletes everything now, regardless of what the GPU is doing.
+void DeletionQueue::flush() {
+  for (Batch &batch : Fenced) {
+    glDeleteSync(batch.fence);
+    release(batch.objects);
+  }
+  Fenced.clear();
+  release(Pending);
+  Pending.clear();
+}
+
+std::size_t DeletionQueue::size() const {
+  std::size_t n = Pending.size();
+  for (const Batch &batch : Fenced) {
+    n += batch.objects.size();
+  }
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Deferred GL Object Deletion
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_DELETION_QUEUE_HPP
+#define MGL_DELETION_QUEUE_HPP
+
+#include <GL/glew.h>
+
+#include <deque>
+#include <vector>
+
+namespace mgl {
+
+class DeletionQueue;
+
+////////////////////////////////////////////////////////////////// DeletionQueue
+//
+// GL objects released during a frame are not deleted right away, where the
+// driver may have to wait for the GPU to stop using them. They are collected
+// until the end of the frame, fenced together, and deleted once the GPU has
+// passed that fence. The engine calls endFrame() after each frame and flush()
+// before its context is destroyed.
+
+class DeletionQueue {
+ public:
+  static DeletionQueue &getInstance();
+
+  void deleteBuffer(GLuint buffer);
+  void deleteVertexArray(GLuint vao);
+  void deleteProgram(GLuint program);
+
+  void endFrame();
+  void flush();
+  std::size_t size() const;
+
+ private:
+  enum Kind { BUFFER, VERTEX_ARRAY, PROGRAM };
+  struct Object {
+    Kind kind;
+    GLuint name;
+  };
+  struct Batch {
+    GLsync fence;
+    std::vector<Object> objects;
+  };
+
+  std::vector<Object> Pending;
+  std::deque<Batch> Fenced;
+
+  DeletionQueue() = default;
+  static void release(const std::vector<Object> &objects);
+
+ public:
+  DeletionQueue(DeletionQueue const &) = delete;
+  void operator=(DeletionQueue const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_DELETION_QUEUE_HPP */
@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Memory Mapped File
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// MappedFile
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : Data(nullptr),
+      Size(0),
+      Opened(false),
+      FileHandle(INVALID_HANDLE_VALUE),
+      MappingHandle(nullptr) {}
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+  FileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                           nullptr);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(FileHandle, &size)) {
+    close();
+    return false;
+  }
+  Size = static_cast<std::size_t>(size.QuadPart);
+  Opened = true;
+  // Empty files cannot be mapped.
+  if (Size > 0) {
+    MappingHandle =
+        CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!MappingHandle) {
+      close();
+      return false;
+    }
+    Data = static_cast<const char *>(
+        MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!Data) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (Data) {
+    UnmapViewOfFile(Data);
+  }
+  if (MappingHandle) {
+    CloseHandle(MappingHandle);
+  }
+  if (FileHandle != INVALID_HANDLE_VALUE) {
+    CloseHandle(FileHandle);
+  }
+  Data = nullptr;
+  Size = 0;
+  Opened = false;
+  FileHandle = INVALID_HANDLE_VALUE;
+  MappingHandle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile()
+    : Data(nullptr), Size(0), Opened(false), Descriptor(-1) {}
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+  Descriptor = ::open(filename.c_str(), O_RDONLY);
+  if (Descriptor < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(Descriptor, &info) != 0) {
+    close();
+    return false;
+  }
+  Size = static_cast<std::size_t>(info.st_size);
+  Opened = true;
+  // Empty files cannot be mapped.
+  if (Size > 0) {
+    void *data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, Descriptor, 0);
+    if (data == MAP_FAILED) {
+      close();
+      return false;
+    }
+    madvise(data, Size, MADV_SEQUENTIAL);
+    Data = static_cast<const char *>(data);
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (Data) {
+    munmap(const_cast<char *>(Data), Size);
+  }
+  if (Descriptor >= 0) {
+    ::close(Descriptor);
+  }
+  Data = nullptr;
+  Size = 0;
+  Opened = false;
+  Descriptor = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::isOpen() const { return Opened; }
+
+const char *MappedFile::data() const { return Data; }
+
+std::size_t MappedFile::size() const { return Size; }
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Memory Mapped File
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_FILE_HPP
+#define MGL_FILE_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace mgl {
+
+class MappedFile;
+class LoadError;
+
+///////////////////////////////////////////////////////////////////// MappedFile
+//
+// Read-only view of a whole file, paged in by the OS on demand.
+
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &filename);
+  void close();
+  bool isOpen() const;
+  const char *data() const;
+  std::size_t size() const;
+
+ private:
+  const char *Data;
+  std::size_t Size;
+  bool Opened;
+#ifdef _WIN32
+  void *FileHandle;
+  void *MappingHandle;
+#else
+  int Descriptor;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////// LoadError
+//
+// Thrown by the readers of asset files, instead of exiting, as they may run
+// on worker threads. The message names the file and what is wrong with it.
+
+class LoadError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_FILE_HPP */
@@ -0,0 +1,250 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous Mesh Loader
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglLoader.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "./mglFile.hpp"
+#include "./mglMesh.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// MeshLoader
+
+const std::size_t MeshLoader::DEFAULT_UPLOAD_BUDGET;
+
+MeshLoader::MeshLoader() {
+  // One core is left to the render thread.
+  const unsigned int cores = std::thread::hardware_concurrency();
+  Threads = cores > 1 ? cores - 1 : 1;
+  UploadBudget = DEFAULT_UPLOAD_BUDGET;
+  UploadContext = nullptr;
+  Stopping = false;
+}
+
+MeshLoader::~MeshLoader() { shutdown(); }
+
+MeshLoader &MeshLoader::getInstance() {
+  static MeshLoader instance;
+  return instance;
+}
+
+// Only takes effect before the first load.
+void MeshLoader::setThreads(unsigned int threads) {
+  Threads = std::max(threads, 1u);
+}
+
+void MeshLoader::setUploadBudget(std::size_t bytes) { UploadBudget = bytes; }
+
+// The context must be shared with the render context and not current on any
+// thread. Call before the first load.
+void MeshLoader::startUploader(GLFWwindow *context) {
+  UploadContext = context;
+  Stopping = false;
+  Uploader = std::thread(&MeshLoader::transfer, this);
+}
+
+void MeshLoader::startWorkers() {
+  Stopping = false;
+  for (unsigned int i = 0; i < Threads; i++) {
+    Workers.emplace_back(&MeshLoader::work, this);
+  }
+}
+
+void MeshLoader::load(Mesh *mesh, const std::string &filename) {
+  if (Workers.empty()) {
+    startWorkers();
+  }
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Tasks.push_back({mesh, filename, std::string()});
+  }
+  TaskReady.notify_one();
+}
+
+void MeshLoader::work() {
+  std::unique_lock<std::mutex> lock(Mutex);
+  for (;;) {
+    TaskReady.wait(lock, [this] { return Stopping || !Tasks.empty(); });
+    if (Stopping) {
+      return;
+    }
+    Task task = std::move(Tasks.front());
+    Tasks.pop_front();
+    Busy.push_back(task.mesh);
+    lock.unlock();
+
+    bool loaded = true;
+    try {
+      task.mesh->load(task.filename);
+    } catch (const LoadError &error) {
+      task.error = error.what();
+      loaded = false;
+    }
+
+    lock.lock();
+    Busy.erase(std::find(Busy.begin(), Busy.end(), task.mesh));
+    if (!loaded) {
+      Failures.push_back(std::move(task));
+    } else if (UploadContext) {
+      Transfers.push_back(task.mesh);
+      TransferReady.notify_one();
+    } else {
+      Uploads.push_back(task.mesh);
+    }
+    TaskDone.notify_all();
+  }
+}
+
+void MeshLoader::transfer() {
+  glfwMakeContextCurrent(UploadContext);
+  std::unique_lock<std::mutex> lock(Mutex);
+  for (;;) {
+    TransferReady.wait(lock, [this] { return Stopping || !Transfers.empty(); });
+    if (Stopping) {
+      break;
+    }
+    Mesh *mesh = Transfers.front();
+    Transfers.pop_front();
+    Busy.push_back(mesh);
+    lock.unlock();
+
+    mesh->createBuffers();
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // The fence must reach the GPU for the render thread to see it signaled.
+    glFlush();
+
+    lock.lock();
+    Busy.erase(std::find(Busy.begin(), Busy.end(), mesh));
+    Fences.push_back({mesh, fence});
+    TaskDone.notify_all();
+  }
+  lock.unlock();
+  glfwMakeContextCurrent(nullptr);
+}
+
+// Fences are polled without waiting, so a transfer still in flight costs the
+// render thread nothing.
+void MeshLoader::finishTransfers() {
+  std::vector<Mesh *> done;
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    while (!Fences.empty()) {
+      const GLenum status = glClientWaitSync(Fences.front().fence, 0, 0);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        break;
+      }
+      glDeleteSync(Fences.front().fence);
+      done.push_back(Fences.front().mesh);
+      Fences.pop_front();
+    }
+  }
+  for (Mesh *mesh : done) {
+    mesh->upload();
+  }
+}
+
+// Called when a pending mesh is destroyed: drops its queued work and waits
+// for a worker that is already parsing it.
+void MeshLoader::cancel(Mesh *mesh) {
+  std::unique_lock<std::mutex> lock(Mutex);
+  auto ofMesh = [mesh](const Task &t) { return t.mesh == mesh; };
+  Tasks.erase(std::remove_if(Tasks.begin(), Tasks.end(), ofMesh), Tasks.end());
+  TaskDone.wait(lock, [this, mesh] {
+    return std::find(Busy.begin(), Busy.end(), mesh) == Busy.end();
+  });
+  Failures.erase(std::remove_if(Failures.begin(), Failures.end(), ofMesh),
+                 Failures.end());
+  Uploads.erase(std::remove(Uploads.begin(), Uploads.end(), mesh),
+                Uploads.end());
+  Transfers.erase(std::remove(Transfers.begin(), Transfers.end(), mesh),
+                  Transfers.end());
+  for (auto it = Fences.begin(); it != Fences.end();) {
+    if (it->mesh == mesh) {
+      glDeleteSync(it->fence);
+      it = Fences.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Exits if a worker failed to load a file. The lock is released first, as
+// exiting destroys the loader, which takes it again.
+void MeshLoader::upload() {
+  std::string error;
+  bool failed = false;
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (!Failures.empty()) {
+      error = Failures.front().error;
+      failed = true;
+    }
+  }
+  if (failed) {
+    std::cerr << "[ERROR] " << error << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  finishTransfers();
+  std::size_t spent = 0;
+  for (;;) {
+    Mesh *mesh = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      if (Uploads.empty()) {
+        return;
+      }
+      const std::size_t size = Uploads.front()->getUploadSize();
+      if (spent > 0 && spent + size > UploadBudget) {
+        return;
+      }
+      spent += size;
+      mesh = Uploads.front();
+      Uploads.pop_front();
+    }
+    mesh->upload();
+  }
+}
+
+bool MeshLoader::isIdle() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  return Tasks.empty() && Busy.empty() && Uploads.empty() &&
+         Transfers.empty() && Fences.empty() && Failures.empty();
+}
+
+// Pending meshes are left unloaded.
+void MeshLoader::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stopping = true;
+  }
+  TaskReady.notify_all();
+  TransferReady.notify_all();
+  for (std::thread &worker : Workers) {
+    worker.join();
+  }
+  Workers.clear();
+  if (Uploader.joinable()) {
+    Uploader.join();
+  }
+  UploadContext = nullptr;
+  for (Transfer &transfer : Fences) {
+    glDeleteSync(transfer.fence);
+  }
+  Tasks.clear();
+  Busy.clear();
+  Uploads.clear();
+  Transfers.clear();
+  Fences.clear();
+  Failures.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous Mesh Loader
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_LOADER_HPP
+#define MGL_LOADER_HPP
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mgl {
+
+class MeshLoader;
+class Mesh;
+
+///////////////////////////////////////////////////////////////////// MeshLoader
+//
+// Files are parsed and post-processed on a pool of worker threads, each task
+// with its own Assimp importer. Parsed meshes wait in a queue until the render
+// thread calls upload(), once per frame, which creates their GL objects until
+// the per-frame byte budget is spent. At least one mesh is uploaded per call,
+// so meshes larger than the budget still make progress.
+//
+// Given a context shared with the render context, an uploader thread creates
+// and fills the buffers instead, and fences them. The render thread then only
+// polls the fences in upload() and creates the vertex arrays, which cannot be
+// shared, once the data has reached the GPU.
+//
+// A worker never exits the program, which would destroy the loader from one
+// of its own threads. A file that fails to load is handed back with its error
+// instead, and reported by upload(), which exits on the render thread.
+
+class MeshLoader {
+ public:
+  static const std::size_t DEFAULT_UPLOAD_BUDGET = 16 << 20;
+
+  static MeshLoader &getInstance();
+
+  void setThreads(unsigned int threads);
+  void setUploadBudget(std::size_t bytes);
+  void startUploader(GLFWwindow *context);
+
+  void load(Mesh *mesh, const std::string &filename);
+  void cancel(Mesh *mesh);
+  void upload();
+  bool isIdle();
+  void shutdown();
+
+ private:
+  struct Task {
+    Mesh *mesh;
+    std::string filename;
+    std::string error;
+  };
+  struct Transfer {
+    Mesh *mesh;
+    GLsync fence;
+  };
+
+  std::vector<std::thread> Workers;
+  std::deque<Task> Tasks;
+  std::deque<Mesh *> Uploads;
+  std::deque<Mesh *> Transfers;
+  std::deque<Transfer> Fences;
+  std::deque<Task> Failures;
+  std::vector<Mesh *> Busy;
+  std::mutex Mutex;
+  std::condition_variable TaskReady;
+  std::condition_variable TaskDone;
+  std::condition_variable TransferReady;
+  std::thread Uploader;
+  GLFWwindow *UploadContext;
+  unsigned int Threads;
+  std::size_t UploadBudget;
+  bool Stopping;
+
+  MeshLoader();
+  ~MeshLoader();
+  void startWorkers();
+  void work();
+  void transfer();
+  void finishTransfers();
+
+ public:
+  MeshLoader(MeshLoader const &) = delete;
+  void operator=(MeshLoader const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_LOADER_HPP */
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Material Table
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMaterials.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "./mglDeletionQueue.hpp"
+#include "./mglState.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////// MaterialBuffer
+
+const std::size_t MaterialBuffer::MIN_CAPACITY;
+
+MaterialBuffer::MaterialBuffer(GLuint bindingpoint) {
+  BindingPoint = bindingpoint;
+  Capacity = 0;
+  DirtyBegin = 0;
+  DirtyEnd = 0;
+  DirectStateAccess = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+  if (DirectStateAccess) {
+    glCreateBuffers(1, &SsboId);
+  } else {
+    glGenBuffers(1, &SsboId);
+  }
+}
+
+MaterialBuffer::~MaterialBuffer() {
+  DeletionQueue::getInstance().deleteBuffer(SsboId);
+}
+
+unsigned int MaterialBuffer::add(const MaterialData &material) {
+  Materials.push_back(material);
+  setDirty(Materials.size() - 1, Materials.size());
+  return static_cast<unsigned int>(Materials.size() - 1);
+}
+
+unsigned int MaterialBuffer::add(const std::vector<MaterialData> &materials) {
+  const std::size_t first = Materials.size();
+  Materials.insert(Materials.end(), materials.begin(), materials.end());
+  setDirty(first, Materials.size());
+  return static_cast<unsigned int>(first);
+}
+
+void MaterialBuffer::set(unsigned int index, const MaterialData &material) {
+  if (index >= Materials.size()) {
+    std::cerr << "[ERROR] Invalid material " << index << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Materials[index] = material;
+  setDirty(index, index + 1);
+}
+
+const MaterialData &MaterialBuffer::get(unsigned int index) const {
+  if (index >= Materials.size()) {
+    std::cerr << "[ERROR] Invalid material " << index << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return Materials[index];
+}
+
+std::size_t MaterialBuffer::size() const { return Materials.size(); }
+
+std::size_t MaterialBuffer::getGpuBytes() const {
+  return sizeof(MaterialData) * Capacity;
+}
+
+void MaterialBuffer::setDirty(std::size_t begin, std::size_t end) {
+  if (DirtyBegin == DirtyEnd) {
+    DirtyBegin = begin;
+    DirtyEnd = end;
+  } else {
+    DirtyBegin = std::min(DirtyBegin, begin);
+    DirtyEnd = std::max(DirtyEnd, end);
+  }
+}
+
+// Storage stays mutable so that it can grow. A grown buffer is refilled
+// whole; its binding point is set once it has storage.
+void MaterialBuffer::upload() {
+  if (DirtyBegin == DirtyEnd) {
+    return;
+  }
+  StateCache &state = StateCache::getInstance();
+  if (Materials.size() > Capacity) {
+    Capacity = std::max({Materials.size(), 2 * Capacity, MIN_CAPACITY});
+    const GLsizeiptr bytes =
+        static_cast<GLsizeiptr>(sizeof(MaterialData) * Capacity);
+    if (DirectStateAccess) {
+      glNamedBufferData(SsboId, bytes, nullptr, GL_DYNAMIC_DRAW);
+    } else {
+      state.bindBuffer(GL_SHADER_STORAGE_BUFFER, SsboId);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+    }
+    DirtyBegin = 0;
+    DirtyEnd = Materials.size();
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoint, SsboId);
+  }
+  const GLintptr offset =
+      static_cast<GLintptr>(sizeof(MaterialData) * DirtyBegin);
+  const GLsizeiptr bytes =
+      static_cast<GLsizeiptr>(sizeof(MaterialData) * (DirtyEnd - DirtyBegin));
+  if (DirectStateAccess) {
+    glNamedBufferSubData(SsboId, offset, bytes, &Materials[DirtyBegin]);
+  } else {
+    state.bindBuffer(GL_SHADER_STORAGE_BUFFER, SsboId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, bytes,
+                    &Materials[DirtyBegin]);
+  }
+  DirtyBegin = 0;
+  DirtyEnd = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
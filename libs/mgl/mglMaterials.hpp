@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Material Table
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MATERIALS_HPP
+#define MGL_MATERIALS_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+struct MaterialData;
+class MaterialBuffer;
+
+/////////////////////////////////////////////////////////////////// MaterialData
+//
+// One entry of the material table, laid out as the std430 array element
+//
+//   struct Material { vec4 Diffuse; vec4 Specular; vec4 Ambient;
+//                     vec4 Emissive; };
+//
+// The scalars travel in the w components: opacity with the diffuse color and
+// shininess with the specular one.
+
+struct MaterialData {
+  glm::vec4 Diffuse = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+  glm::vec4 Specular = glm::vec4(0.0f);
+  glm::vec4 Ambient = glm::vec4(0.0f);
+  glm::vec4 Emissive = glm::vec4(0.0f);
+};
+
+static_assert(sizeof(MaterialData) == 4 * sizeof(glm::vec4),
+              "MaterialData must match its std430 layout");
+
+///////////////////////////////////////////////////////////////// MaterialBuffer
+//
+// Materials of every mesh in a scene, in a single shader storage buffer bound
+// to a fixed binding point. Shaders index it with the material of the draw,
+// which Mesh passes as the base instance, so a mesh with several materials is
+// drawn without any uniform upload between its submeshes. Entries are edited
+// on the CPU and the changed range is sent by upload(); the buffer is
+// reallocated, at least doubling, when the table outgrows it.
+
+class MaterialBuffer {
+ public:
+  static const std::size_t MIN_CAPACITY = 64;
+
+  explicit MaterialBuffer(GLuint bindingpoint);
+  ~MaterialBuffer();
+  MaterialBuffer(const MaterialBuffer &) = delete;
+  MaterialBuffer &operator=(const MaterialBuffer &) = delete;
+
+  // Both return the index of the first added entry.
+  unsigned int add(const MaterialData &material);
+  unsigned int add(const std::vector<MaterialData> &materials);
+  void set(unsigned int index, const MaterialData &material);
+  const MaterialData &get(unsigned int index) const;
+  std::size_t size() const;
+  void upload();
+  std::size_t getGpuBytes() const;
+
+ private:
+  GLuint SsboId;
+  GLuint BindingPoint;
+  bool DirectStateAccess;
+  std::size_t Capacity;
+  std::size_t DirtyBegin, DirtyEnd;
+  std::vector<MaterialData> Materials;
+
+  void setDirty(std::size_t begin, std::size_t end);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_MATERIALS_HPP */
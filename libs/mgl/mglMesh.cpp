@@ -8,21 +8,64 @@
 
 #include "./mglMesh.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <type_traits>
+#include <unordered_set>
+
+#include "./mglBaked.hpp"
+#include "./mglDeletionQueue.hpp"
+#include "./mglLoader.hpp"
+#include "./mglObj.hpp"
+#include "./mglOptimize.hpp"
+#include "./mglPack.hpp"
+#include "./mglParallel.hpp"
+#include "./mglState.hpp"
+#include "./mglTangents.hpp"
 
 namespace mgl {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+const float Mesh::DEFAULT_WELD_EPSILON = 1.0e-6f;
+const unsigned int Mesh::LOD_RESOLUTION = 64;
+
 Mesh::Mesh() {
   NormalsLoaded = false;
   TexcoordsLoaded = false;
   TangentsAndBitangentsLoaded = false;
+  BonesLoaded = false;
+  Layout = nullptr;
+  Ready = false;
+  Pending = false;
+  GpuBytes = 0;
+  RetentionPolicy = KEEP_ALL;
+  NativeReaders = true;
+  LoadThreads = 1;
+  Weld = false;
+  WeldEpsilon = DEFAULT_WELD_EPSILON;
+  NativeTangents = false;
+  PackedTangents = false;
+  OptimizeCache = false;
+  LodLevels = 0;
+  Lod = 0;
+  VertexCount = 0;
   VaoId = -1;
+  VertexBufferId = 0;
+  IndexBufferId = 0;
   AssimpFlags = aiProcess_Triangulate;
+  FlatHierarchy = true;
 }
 
-Mesh::~Mesh() { destroyBufferObjects(); }
+Mesh::~Mesh() {
+  if (Pending) {
+    MeshLoader::getInstance().cancel(this);
+  }
+  destroyBufferObjects();
+}
 
 void Mesh::setAssimpFlags(unsigned int flags) { AssimpFlags = flags; }
 
@@ -42,50 +85,240 @@ void Mesh::calculateTangentSpace() {
   AssimpFlags |= aiProcess_CalcTangentSpace;
 }
 
+// Native, multithreaded alternative to calculateTangentSpace(), run after
+// welding. Packed tangents drop the bitangent stream, which the vertex shader
+// rebuilds from the sign in the tangent's w.
+void Mesh::generateTangents(bool packed) {
+  NativeTangents = true;
+  PackedTangents = packed;
+  AssimpFlags &= ~aiProcess_CalcTangentSpace;
+}
+
 void Mesh::flipUVs() { AssimpFlags |= aiProcess_FlipUVs; }
 
+void Mesh::useNativeReaders(bool native) { NativeReaders = native; }
+
+// Welds vertices whose attributes all round to the same multiple of epsilon,
+// in place of aiProcess_JoinIdenticalVertices. Rounding snaps to a grid, so
+// vertices closer than epsilon but on either side of a cell boundary are kept
+// apart. An epsilon of 0 only welds exact copies.
+void Mesh::weldVertices(float epsilon) {
+  Weld = true;
+  WeldEpsilon = epsilon;
+  AssimpFlags &= ~aiProcess_JoinIdenticalVertices;
+}
+
+// Reorders the triangles of each submesh for the post-transform cache, after
+// welding and tangent generation.
+void Mesh::optimizeVertexCache() { OptimizeCache = true; }
+
+// Adds coarser index ranges over the same vertices, each level clustering
+// vertices on a grid half as fine as the one before. Level 0 is the mesh as
+// loaded.
+void Mesh::generateLods(unsigned int levels) { LodLevels = levels; }
+
+// Threads used by the CPU stages of load(): the native readers split large
+// files into chunks, and welding splits the vertices. 0 uses one thread per
+// hardware thread.
+void Mesh::setLoadThreads(unsigned int threads) { LoadThreads = threads; }
+
+// Must be called before create(); by default the format follows the streams
+// found in the file.
+void Mesh::setVertexLayout(const VertexLayout &layout) { Layout = &layout; }
+
+// Must be called before the mesh is uploaded. Submesh ranges and bounds are
+// always kept.
+void Mesh::setRetention(Retention retention) { RetentionPolicy = retention; }
+
 bool Mesh::hasNormals() { return NormalsLoaded; }
 
 bool Mesh::hasTexcoords() { return TexcoordsLoaded; }
 
 bool Mesh::hasTangentsAndBitangents() { return TangentsAndBitangentsLoaded; }
 
+bool Mesh::hasBones() { return BonesLoaded; }
+
+const Bounds &Mesh::getBounds() const { return MeshBounds; }
+
+// Vertices as uploaded, after welding; still known once streams are released.
+std::size_t Mesh::getVertexCount() const { return VertexCount; }
+
+std::size_t Mesh::getTriangleCount(unsigned int level) const {
+  std::size_t indices = 0;
+  for (std::size_t i = 0; i < Meshes.size(); i++) {
+    indices += level == 0 ? Meshes[i].nIndices
+                          : Lods[(level - 1) * Meshes.size() + i].nIndices;
+  }
+  return indices / 3;
+}
+
+unsigned int Mesh::getLodCount() const {
+  return Meshes.empty()
+             ? 1
+             : static_cast<unsigned int>(1 + Lods.size() / Meshes.size());
+}
+
+// Vertices transformed per triangle, over every submesh of a level. Needs
+// the indices, so 0 once they are released.
+float Mesh::getCacheMissRatio(unsigned int level) const {
+  if (Indices.empty()) {
+    return 0.0f;
+  }
+  float misses = 0.0f;
+  std::size_t triangles = 0;
+  for (std::size_t i = 0; i < Meshes.size(); i++) {
+    const MeshData &mesh =
+        level == 0 ? Meshes[i] : Lods[(level - 1) * Meshes.size() + i];
+    if (mesh.nIndices == 0) {
+      continue;
+    }
+    misses += computeCacheMissRatio(&Indices[mesh.baseIndex], mesh.nIndices,
+                                    mesh.nVertices) *
+              (mesh.nIndices / 3);
+    triangles += mesh.nIndices / 3;
+  }
+  return triangles > 0 ? misses / triangles : 0.0f;
+}
+
+const std::vector<Mesh::DrawRecord> &Mesh::getDrawRecords() const {
+  return DrawRecords;
+}
+
+// Indexed by the material of each submesh. Kept whatever the retention, so
+// that the table can be filled once the mesh is ready.
+const std::vector<MaterialData> &Mesh::getMaterials() const {
+  return Materials;
+}
+
+// Kept whatever the retention, as every character posed with the mesh needs
+// them.
+const Skeleton &Mesh::getSkeleton() const { return MeshSkeleton; }
+
+const std::vector<AnimationClip> &Mesh::getAnimationClips() const {
+  return Clips;
+}
+
+bool Mesh::hasMorphTargets() { return !Morphs.empty(); }
+
+// Kept whatever the retention, so that the targets can be added to a
+// MorphBuffer once the mesh is ready. Offsets are indexed by the vertices as
+// uploaded, after welding.
+const MorphTargets &Mesh::getMorphTargets() const { return Morphs; }
+
+// Vertex streams, for CPU skinning. Empty once uploaded, unless retained.
+const std::vector<glm::vec3> &Mesh::getPositions() const { return Positions; }
+
+const std::vector<glm::vec3> &Mesh::getNormals() const { return Normals; }
+
+const std::vector<unsigned int> &Mesh::getIndices() const { return Indices; }
+
+const std::vector<glm::u8vec4> &Mesh::getBoneIndices() const {
+  return BoneIndices;
+}
+
+const std::vector<glm::u8vec4> &Mesh::getBoneWeights() const {
+  return BoneWeights;
+}
+
+// Skinned meshes are drawn with SkinnedVertex, which has no tangent space.
+const VertexLayout &Mesh::getVertexLayout() const {
+  if (Layout) {
+    return *Layout;
+  }
+  if (BonesLoaded) {
+    return SkinnedVertex::layout();
+  }
+  if (TangentsAndBitangentsLoaded) {
+    return PackedTangents ? PackedTangentSpaceVertex::layout()
+                          : TangentSpaceVertex::layout();
+  }
+  if (NormalsLoaded && TexcoordsLoaded) {
+    return PositionNormalTexcoordVertex::layout();
+  }
+  if (NormalsLoaded) {
+    return PositionNormalVertex::layout();
+  }
+  if (TexcoordsLoaded) {
+    return PositionTexcoordVertex::layout();
+  }
+  return PositionVertex::layout();
+}
+
+// Maps each vertex as loaded to its vertex after welding. Empty if the mesh
+// was not welded, and released along with the vertex attributes.
+const std::vector<unsigned int> &Mesh::getWeldRemap() const {
+  return WeldRemap;
+}
+
+// Meshes with the same vertex layout share a format id.
+unsigned int Mesh::getVertexFormat() const { return getVertexLayout().Id; }
+
 ////////////////////////////////////////////////////////////////////////////////
 
+// Streams are resized once per mesh and filled in place.
 void Mesh::processMesh(const aiMesh *mesh) {
   NormalsLoaded = mesh->HasNormals();
   // Check if mesh has texture coordinates in the primary (0th) UV channel
   TexcoordsLoaded = mesh->HasTextureCoords(0);
   TangentsAndBitangentsLoaded = mesh->HasTangentsAndBitangents();
 
-  for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+  const std::size_t base = Positions.size();
+  const unsigned int n = mesh->mNumVertices;
+  Positions.resize(base + n);
+  for (unsigned int i = 0; i < n; i++) {
     const aiVector3D &aiPosition = mesh->mVertices[i];
-    Positions.push_back(glm::vec3(aiPosition.x, aiPosition.y, aiPosition.z));
-    if (NormalsLoaded) {
+    Positions[base + i] = glm::vec3(aiPosition.x, aiPosition.y, aiPosition.z);
+  }
+  if (NormalsLoaded) {
+    Normals.resize(base + n);
+    for (unsigned int i = 0; i < n; i++) {
       const aiVector3D &aiNormal = mesh->mNormals[i];
-      Normals.push_back(glm::vec3(aiNormal.x, aiNormal.y, aiNormal.z));
+      Normals[base + i] = glm::vec3(aiNormal.x, aiNormal.y, aiNormal.z);
     }
-    if (TexcoordsLoaded) {
+  }
+  if (TexcoordsLoaded) {
+    Texcoords.resize(base + n);
+    for (unsigned int i = 0; i < n; i++) {
       const aiVector3D &aiTexcoord = mesh->mTextureCoords[0][i];
-      Texcoords.push_back(glm::vec2(aiTexcoord.x, aiTexcoord.y));
+      Texcoords[base + i] = glm::vec2(aiTexcoord.x, aiTexcoord.y);
     }
-    if (TangentsAndBitangentsLoaded) {
-      const aiVector3D &aiTangent = mesh->mTangents[i];
-      Tangents.push_back(glm::vec3(aiTangent.x, aiTangent.y, aiTangent.z));
-
+  }
+  if (TangentsAndBitangentsLoaded) {
+    // The handedness goes in w, as the native generator writes it.
+    Tangents.resize(base + n);
 #ifdef CREATE_BITANGENT
+    Bitangents.resize(base + n);
+#endif
+    for (unsigned int i = 0; i < n; i++) {
+      const aiVector3D &aiTangent = mesh->mTangents[i];
       const aiVector3D &aiBitangent = mesh->mBitangents[i];
-      Bitangents.push_back(
-          glm::vec3(aiBitangent.x, aiBitangent.y, aiBitangent.z));
+      const glm::vec3 tangent(aiTangent.x, aiTangent.y, aiTangent.z);
+      const glm::vec3 bitangent(aiBitangent.x, aiBitangent.y, aiBitangent.z);
+      float sign = 1.0f;
+      if (NormalsLoaded &&
+          glm::dot(glm::cross(Normals[base + i], tangent), bitangent) < 0.0f) {
+        sign = -1.0f;
+      }
+      Tangents[base + i] = glm::vec4(tangent, sign);
+#ifdef CREATE_BITANGENT
+      Bitangents[base + i] = bitangent;
 #endif
     }
   }
+  if (BonesLoaded && mesh->HasBones()) {
+    processBones(mesh, base);
+  }
+  if (!Morphs.empty()) {
+    processMorphs(mesh);
+  }
+  const std::size_t base_index = Indices.size();
+  Indices.resize(base_index + mesh->mNumFaces * 3);
   for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
     // Assuming all mesh faces are triangles
     const aiFace &face = mesh->mFaces[i];
-    Indices.push_back(face.mIndices[0]);
-    Indices.push_back(face.mIndices[1]);
-    Indices.push_back(face.mIndices[2]);
+    Indices[base_index + i * 3] = face.mIndices[0];
+    Indices[base_index + i * 3 + 1] = face.mIndices[1];
+    Indices[base_index + i * 3 + 2] = face.mIndices[2];
   }
 }
 
@@ -97,8 +330,828 @@ void Mesh::clear() {
 #ifdef CREATE_BITANGENT
   Bitangents.clear();
 #endif
+  BoneIndices.clear();
+  BoneWeights.clear();
+  BonesLoaded = false;
   Indices.clear();
+  WeldRemap.clear();
+  MeshSkeleton = Skeleton();
+  Clips.clear();
+  Morphs = MorphTargets();
   Meshes.clear();
+  Lods.clear();
+  Lod = 0;
+  VertexData.clear();
+  VertexCount = 0;
+  DrawRecords.clear();
+  Materials.clear();
+  FlatHierarchy = true;
+  MeshBounds = Bounds();
+}
+
+void Mesh::computeBounds() {
+  // Per submesh: AABB, then a sphere centered on it whose radius reaches the
+  // farthest vertex, which is tighter than half the box diagonal.
+  for (MeshData &mesh : Meshes) {
+    if (mesh.nVertices == 0) {
+      continue;
+    }
+    const glm::vec3 *positions = &Positions[mesh.baseVertex];
+    Bounds &bounds = mesh.bounds;
+    bounds.min = bounds.max = positions[0];
+    for (unsigned int i = 1; i < mesh.nVertices; i++) {
+      bounds.min = glm::min(bounds.min, positions[i]);
+      bounds.max = glm::max(bounds.max, positions[i]);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radius2 = 0.0f;
+    for (unsigned int i = 0; i < mesh.nVertices; i++) {
+      const glm::vec3 d = positions[i] - bounds.center;
+      radius2 = glm::max(radius2, glm::dot(d, d));
+    }
+    bounds.radius = glm::sqrt(radius2);
+  }
+
+  // The whole mesh covers every placed submesh: boxes are transformed corner
+  // by corner, and spheres are scaled by the largest axis of the placement.
+  bool first = true;
+  for (const DrawRecord &record : DrawRecords) {
+    const MeshData &mesh = Meshes[record.Submesh];
+    if (mesh.nVertices == 0) {
+      continue;
+    }
+    for (int c = 0; c < 8; c++) {
+      const glm::vec3 corner(c & 1 ? mesh.bounds.max.x : mesh.bounds.min.x,
+                             c & 2 ? mesh.bounds.max.y : mesh.bounds.min.y,
+                             c & 4 ? mesh.bounds.max.z : mesh.bounds.min.z);
+      const glm::vec3 p(record.Transform * glm::vec4(corner, 1.0f));
+      MeshBounds.min = first ? p : glm::min(MeshBounds.min, p);
+      MeshBounds.max = first ? p : glm::max(MeshBounds.max, p);
+      first = false;
+    }
+  }
+
+  MeshBounds.center = (MeshBounds.min + MeshBounds.max) * 0.5f;
+  MeshBounds.radius = 0.0f;
+  for (const DrawRecord &record : DrawRecords) {
+    const MeshData &mesh = Meshes[record.Submesh];
+    if (mesh.nVertices > 0) {
+      const glm::mat4 &m = record.Transform;
+      const float scale = glm::max(
+          glm::length(glm::vec3(m[0])),
+          glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+      const glm::vec3 center(m * glm::vec4(mesh.bounds.center, 1.0f));
+      const float d = glm::length(center - MeshBounds.center);
+      MeshBounds.radius =
+          glm::max(MeshBounds.radius, d + mesh.bounds.radius * scale);
+    }
+  }
+}
+
+// Submeshes are independent, so they are spread over the load threads.
+void Mesh::optimizeIndices() {
+  const std::size_t threads = std::max<std::size_t>(
+      std::min<std::size_t>(resolveThreads(LoadThreads), Meshes.size()), 1);
+  runParallel(threads, [&](std::size_t r) {
+    for (std::size_t i = r; i < Meshes.size(); i += threads) {
+      const MeshData &mesh = Meshes[i];
+      if (mesh.nIndices == 0) {
+        continue;
+      }
+      mgl::optimizeVertexCache(&Indices[mesh.baseIndex], mesh.nIndices,
+                               mesh.nVertices);
+    }
+  });
+}
+
+// Grids are sized on the largest extent of each submesh. Level indices are
+// appended after those of level 0, with the same base vertices.
+void Mesh::computeLods() {
+  const std::size_t submeshes = Meshes.size();
+  Lods.resize(LodLevels * submeshes);
+  for (unsigned int level = 1; level <= LodLevels; level++) {
+    const unsigned int resolution = std::max(LOD_RESOLUTION >> (level - 1), 1u);
+    for (std::size_t i = 0; i < submeshes; i++) {
+      const MeshData &mesh = Meshes[i];
+      MeshData &lod = Lods[(level - 1) * submeshes + i];
+      lod = mesh;
+      lod.baseIndex = static_cast<unsigned int>(Indices.size());
+      lod.nIndices = 0;
+      if (mesh.nIndices == 0) {
+        continue;
+      }
+      const glm::vec3 extent = mesh.bounds.max - mesh.bounds.min;
+      const float cell =
+          glm::max(extent.x, glm::max(extent.y, extent.z)) / resolution;
+      std::vector<unsigned int> indices =
+          simplifyClusters(&Positions[mesh.baseVertex],
+                           &Indices[mesh.baseIndex], mesh.nIndices, cell);
+      if (OptimizeCache) {
+        mgl::optimizeVertexCache(indices.data(), indices.size(),
+                                 mesh.nVertices);
+      }
+      lod.nIndices = static_cast<unsigned int>(indices.size());
+      Indices.insert(Indices.end(), indices.begin(), indices.end());
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////// VERTEX WELDING
+//
+// Every attribute is quantized to a grid of epsilon, as a 64-bit integer, and
+// vertices of the same submesh with equal quantized attributes are welded. Vertices are hashed in
+// parallel and spread by hash over one partition per thread, where the first
+// vertex of each key is kept. Kept vertices stay in their loaded order, so
+// submeshes stay contiguous.
+
+static const std::size_t MIN_WELD_VERTICES = 1 << 14;
+
+class WeldKey {
+ public:
+  explicit WeldKey(float epsilon) {
+    Scale = epsilon > 0.0f ? 1.0 / epsilon : 0.0;
+    Count = 0;
+    RunOffsets = nullptr;
+    RunData = nullptr;
+    RunStride = 0;
+  }
+
+  void add(const float *data, unsigned int size) {
+    Streams[Count++] = {data, nullptr, size};
+  }
+
+  // Four bytes per vertex, compared exactly.
+  void addPacked(const void *data) {
+    Streams[Count++] = {nullptr, static_cast<const unsigned char *>(data), 1};
+  }
+
+  // Items of stride bytes, vertex v owning those from offsets[v] up to
+  // offsets[v + 1]. They are compared exactly but not hashed, so a digest of
+  // them should be added as well.
+  void setRuns(const unsigned int *offsets, const void *data,
+               std::size_t stride) {
+    RunOffsets = offsets;
+    RunData = static_cast<const unsigned char *>(data);
+    RunStride = stride;
+  }
+
+  uint64_t hash(std::size_t v, unsigned int submesh) const {
+    uint64_t h = submesh * 0x9E3779B97F4A7C15ull;
+    for (unsigned int s = 0; s < Count; s++) {
+      for (unsigned int c = 0; c < Streams[s].size; c++) {
+        h ^= static_cast<uint64_t>(component(s, v, c)) + (h << 6) + (h >> 2);
+        h *= 0xC2B2AE3D27D4EB4Full;
+      }
+    }
+    return h ^ (h >> 29);
+  }
+
+  bool equal(std::size_t a, std::size_t b) const {
+    for (unsigned int s = 0; s < Count; s++) {
+      for (unsigned int c = 0; c < Streams[s].size; c++) {
+        if (component(s, a, c) != component(s, b, c)) {
+          return false;
+        }
+      }
+    }
+    if (RunOffsets) {
+      const std::size_t size = RunOffsets[a + 1] - RunOffsets[a];
+      if (RunOffsets[b + 1] - RunOffsets[b] != size) {
+        return false;
+      }
+      if (size > 0 && std::memcmp(RunData + RunOffsets[a] * RunStride,
+                                  RunData + RunOffsets[b] * RunStride,
+                                  size * RunStride) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // False if a quantized attribute of the first n vertices would not fit in
+  // 64 bits, or is not a number.
+  bool fits(std::size_t n) const {
+    if (Scale == 0.0) {
+      return true;
+    }
+    for (unsigned int s = 0; s < Count; s++) {
+      if (Streams[s].packed) {
+        continue;
+      }
+      for (std::size_t i = 0; i < n * Streams[s].size; i++) {
+        if (!(std::fabs(Streams[s].data[i]) * Scale < 9223372036854775808.0)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Compares the float bits instead of the quantized values.
+  void exact() { Scale = 0.0; }
+
+ private:
+  struct Stream {
+    const float *data;
+    const unsigned char *packed;
+    unsigned int size;
+  };
+  Stream Streams[SEMANTICS];
+  unsigned int Count;
+  double Scale;
+  const unsigned int *RunOffsets;
+  const unsigned char *RunData;
+  std::size_t RunStride;
+
+  // Without an epsilon the float bits are compared, with -0 equal to 0.
+  int64_t component(unsigned int s, std::size_t v, unsigned int c) const {
+    if (Streams[s].packed) {
+      uint32_t bits;
+      std::memcpy(&bits, Streams[s].packed + v * 4, sizeof(bits));
+      return bits;
+    }
+    const float x = Streams[s].data[v * Streams[s].size + c];
+    if (Scale == 0.0) {
+      uint32_t bits = 0;
+      if (x != 0.0f) {
+        std::memcpy(&bits, &x, sizeof(bits));
+      }
+      return bits;
+    }
+    return static_cast<int64_t>(std::floor(x * Scale + 0.5));
+  }
+};
+
+void Mesh::weld() {
+  const std::size_t n = Positions.size();
+  if (n == 0) {
+    return;
+  }
+  WeldKey key(WeldEpsilon);
+  key.add(&Positions[0].x, 3);
+  if (Normals.size() == n) {
+    key.add(&Normals[0].x, 3);
+  }
+  if (Texcoords.size() == n) {
+    key.add(&Texcoords[0].x, 2);
+  }
+  if (Tangents.size() == n) {
+    key.add(&Tangents[0].x, 4);
+  }
+#ifdef CREATE_BITANGENT
+  if (Bitangents.size() == n) {
+    key.add(&Bitangents[0].x, 3);
+  }
+#endif
+  if (BoneIndices.size() == n) {
+    key.addPacked(&BoneIndices[0]);
+    key.addPacked(&BoneWeights[0]);
+  }
+  // Vertices are only welded if their deltas match too: hashed by digest,
+  // compared bit for bit.
+  std::vector<uint32_t> morphs;
+  if (Morphs.getVertexCount() == n) {
+    morphs.resize(n);
+    for (std::size_t v = 0; v < n; v++) {
+      const unsigned int end = Morphs.Offsets[v + 1];
+      uint32_t h = 2166136261u;
+      for (unsigned int i = Morphs.Offsets[v]; i < end; i++) {
+        uint32_t words[sizeof(MorphDelta) / sizeof(uint32_t)];
+        std::memcpy(words, &Morphs.Deltas[i], sizeof(words));
+        for (uint32_t word : words) {
+          h = (h ^ word) * 16777619u;
+        }
+      }
+      morphs[v] = h;
+    }
+    key.addPacked(&morphs[0]);
+    key.setRuns(Morphs.Offsets.data(), Morphs.Deltas.data(),
+                sizeof(MorphDelta));
+  }
+  if (!key.fits(n)) {
+    std::cerr << "[WARNING] Attributes too large to weld on a grid of "
+              << WeldEpsilon << ", welding exact copies only" << std::endl;
+    key.exact();
+  }
+  const std::size_t threads =
+      std::max<std::size_t>(std::min<std::size_t>(resolveThreads(LoadThreads),
+                                                  n / MIN_WELD_VERTICES),
+                            1);
+  auto submeshOf = [this](std::size_t v) {
+    auto after = std::upper_bound(Meshes.begin(), Meshes.end(), v,
+                                  [](std::size_t v, const MeshData &mesh) {
+                                    return v < mesh.baseVertex;
+                                  });
+    return static_cast<unsigned int>(after - Meshes.begin() - 1);
+  };
+
+  // Hash, and bucket each range by partition.
+  std::vector<uint64_t> hashes(n);
+  std::vector<unsigned int> owners(n);
+  std::vector<std::vector<unsigned int>> buckets(threads * threads);
+  runParallel(threads, [&](std::size_t r) {
+    const std::size_t end = rangeBegin(n, threads, r + 1);
+    std::size_t v = rangeBegin(n, threads, r);
+    for (unsigned int s = submeshOf(v); v < end; v++) {
+      while (s + 1 < Meshes.size() && v >= Meshes[s + 1].baseVertex) {
+        s++;
+      }
+      owners[v] = s;
+      hashes[v] = key.hash(v, s);
+      buckets[r * threads + (hashes[v] >> 48) % threads].push_back(
+          static_cast<unsigned int>(v));
+    }
+  });
+
+  // Each partition sees its vertices in loaded order, and keeps the first.
+  WeldRemap.resize(n);
+  runParallel(threads, [&](std::size_t p) {
+    std::size_t count = 0;
+    for (std::size_t r = 0; r < threads; r++) {
+      count += buckets[r * threads + p].size();
+    }
+    std::size_t size = 16;
+    while (size < count * 2) {
+      size *= 2;
+    }
+    std::vector<unsigned int> slots(size, ~0u);
+    for (std::size_t r = 0; r < threads; r++) {
+      for (unsigned int v : buckets[r * threads + p]) {
+        std::size_t i = hashes[v] & (size - 1);
+        for (; slots[i] != ~0u; i = (i + 1) & (size - 1)) {
+          const unsigned int u = slots[i];
+          if (hashes[u] == hashes[v] && owners[u] == owners[v] &&
+              key.equal(u, v)) {
+            break;
+          }
+        }
+        if (slots[i] == ~0u) {
+          slots[i] = v;
+        }
+        WeldRemap[v] = slots[i];
+      }
+    }
+  });
+  std::vector<std::vector<unsigned int>>().swap(buckets);
+  std::vector<uint64_t>().swap(hashes);
+
+  // Number the kept vertices, then point the welded ones at them.
+  std::vector<unsigned char> kept(n);
+  std::vector<std::size_t> offsets(threads + 1, 0);
+  runParallel(threads, [&](std::size_t r) {
+    std::size_t count = 0;
+    for (std::size_t v = rangeBegin(n, threads, r);
+         v < rangeBegin(n, threads, r + 1); v++) {
+      kept[v] = WeldRemap[v] == v;
+      count += kept[v];
+    }
+    offsets[r + 1] = count;
+  });
+  for (std::size_t r = 0; r < threads; r++) {
+    offsets[r + 1] += offsets[r];
+  }
+  runParallel(threads, [&](std::size_t r) {
+    unsigned int next = static_cast<unsigned int>(offsets[r]);
+    for (std::size_t v = rangeBegin(n, threads, r);
+         v < rangeBegin(n, threads, r + 1); v++) {
+      if (kept[v]) {
+        WeldRemap[v] = next++;
+      }
+    }
+  });
+  runParallel(threads, [&](std::size_t r) {
+    for (std::size_t v = rangeBegin(n, threads, r);
+         v < rangeBegin(n, threads, r + 1); v++) {
+      if (!kept[v]) {
+        WeldRemap[v] = WeldRemap[WeldRemap[v]];
+      }
+    }
+  });
+
+  const std::size_t welded = offsets[threads];
+  auto compact = [&](auto &stream) {
+    if (stream.size() != n) {
+      return;
+    }
+    typename std::remove_reference<decltype(stream)>::type out(welded);
+    runParallel(threads, [&](std::size_t r) {
+      for (std::size_t v = rangeBegin(n, threads, r);
+           v < rangeBegin(n, threads, r + 1); v++) {
+        if (kept[v]) {
+          out[WeldRemap[v]] = stream[v];
+        }
+      }
+    });
+    stream.swap(out);
+  };
+  compact(Positions);
+  compact(Normals);
+  compact(Texcoords);
+  compact(Tangents);
+#ifdef CREATE_BITANGENT
+  compact(Bitangents);
+#endif
+  compact(BoneIndices);
+  compact(BoneWeights);
+  // Kept vertices stay in order, so their deltas are packed in place.
+  if (!morphs.empty()) {
+    unsigned int count = 0;
+    std::size_t next_vertex = 0;
+    for (std::size_t v = 0; v < n; v++) {
+      if (!kept[v]) {
+        continue;
+      }
+      const unsigned int begin = Morphs.Offsets[v];
+      const unsigned int end = Morphs.Offsets[v + 1];
+      Morphs.Offsets[next_vertex++] = count;
+      std::copy(Morphs.Deltas.begin() + begin, Morphs.Deltas.begin() + end,
+                Morphs.Deltas.begin() + count);
+      count += end - begin;
+    }
+    Morphs.Offsets[next_vertex] = count;
+    Morphs.Offsets.resize(welded + 1);
+    Morphs.Deltas.resize(count);
+    std::vector<uint32_t>().swap(morphs);
+  }
+
+  // The first vertex of a submesh is always kept, so the welded submesh
+  // starts at its remapped base and ends where the next one starts.
+  const std::vector<MeshData> loaded = Meshes;
+  std::size_t next = welded;
+  for (std::size_t i = Meshes.size(); i-- > 0;) {
+    MeshData &mesh = Meshes[i];
+    if (mesh.nVertices > 0) {
+      mesh.baseVertex = WeldRemap[mesh.baseVertex];
+    } else {
+      mesh.baseVertex = static_cast<unsigned int>(next);
+    }
+    mesh.nVertices = static_cast<unsigned int>(next - mesh.baseVertex);
+    next = mesh.baseVertex;
+  }
+  runParallel(threads, [&](std::size_t r) {
+    const std::size_t end = rangeBegin(Indices.size(), threads, r + 1);
+    std::size_t i = rangeBegin(Indices.size(), threads, r);
+    for (std::size_t m = 0; m < loaded.size(); m++) {
+      const std::size_t mesh_end = loaded[m].baseIndex + loaded[m].nIndices;
+      for (; i < end && i < mesh_end; i++) {
+        Indices[i] = WeldRemap[loaded[m].baseVertex + Indices[i]] -
+                     Meshes[m].baseVertex;
+      }
+    }
+  });
+
+#ifdef DEBUG
+  std::cout << "Welded " << n << " vertices into " << welded << std::endl;
+#endif
+}
+
+// Needs normals and texcoords; without them the mesh has no tangent space.
+void Mesh::computeTangents() {
+  const std::size_t n = Positions.size();
+  if (n == 0 || Normals.size() != n || Texcoords.size() != n) {
+#ifdef DEBUG
+    std::cout << "Tangents need normals and texcoords" << std::endl;
+#endif
+    return;
+  }
+  TangentGenerator generator;
+  generator.setThreads(LoadThreads);
+  generator.setVertices(Positions.data(), Normals.data(), Texcoords.data(), n);
+  for (const MeshData &mesh : Meshes) {
+    generator.addTriangles(Indices.data() + mesh.baseIndex, mesh.nIndices,
+                           mesh.baseVertex);
+  }
+  Tangents.resize(n);
+#ifdef CREATE_BITANGENT
+  if (!PackedTangents) {
+    Bitangents.resize(n);
+    generator.generate(Tangents.data(), Bitangents.data());
+  } else {
+    std::vector<glm::vec3>().swap(Bitangents);
+    generator.generate(Tangents.data());
+  }
+#else
+  generator.generate(Tangents.data());
+#endif
+  TangentsAndBitangentsLoaded = true;
+}
+
+// Colors missing from a material keep the defaults of MaterialData.
+void Mesh::processMaterials(const aiScene *scene) {
+  Materials.resize(scene->mNumMaterials);
+  for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+    const aiMaterial *material = scene->mMaterials[i];
+    MaterialData &data = Materials[i];
+    aiColor3D color;
+    if (material->Get(AI_MATKEY_COLOR_DIFFUSE, color) == aiReturn_SUCCESS) {
+      data.Diffuse = glm::vec4(color.r, color.g, color.b, data.Diffuse.w);
+    }
+    if (material->Get(AI_MATKEY_COLOR_SPECULAR, color) == aiReturn_SUCCESS) {
+      data.Specular = glm::vec4(color.r, color.g, color.b, data.Specular.w);
+    }
+    if (material->Get(AI_MATKEY_COLOR_AMBIENT, color) == aiReturn_SUCCESS) {
+      data.Ambient = glm::vec4(color.r, color.g, color.b, 0.0f);
+    }
+    if (material->Get(AI_MATKEY_COLOR_EMISSIVE, color) == aiReturn_SUCCESS) {
+      data.Emissive = glm::vec4(color.r, color.g, color.b, 0.0f);
+    }
+    float value;
+    if (material->Get(AI_MATKEY_OPACITY, value) == aiReturn_SUCCESS) {
+      data.Diffuse.w = value;
+    }
+    if (material->Get(AI_MATKEY_SHININESS, value) == aiReturn_SUCCESS) {
+      data.Specular.w = value;
+    }
+  }
+  // Assimp always adds a default material, so this only guards odd scenes.
+  if (Materials.empty()) {
+    Materials.resize(1);
+  }
+}
+
+// Assimp matrices are row major.
+static glm::mat4 toMat4(const aiMatrix4x4 &matrix) {
+  return glm::transpose(glm::make_mat4(&matrix.a1));
+}
+
+// Walks the node tree once, depth first, keeping the order of the children.
+void Mesh::processNodes(const aiNode *root) {
+  std::vector<std::pair<const aiNode *, glm::mat4>> stack;
+  stack.push_back({root, glm::mat4(1.0f)});
+  while (!stack.empty()) {
+    const aiNode *node = stack.back().first;
+    const glm::mat4 world = stack.back().second * toMat4(node->mTransformation);
+    stack.pop_back();
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+      DrawRecords.push_back({node->mMeshes[i], world});
+    }
+    for (unsigned int i = node->mNumChildren; i-- > 0;) {
+      stack.push_back({node->mChildren[i], world});
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////// SKELETAL IMPORT
+
+// Bones are numbered in order of first use across the meshes, and must fit
+// the byte indices of SkinnedVertex. Assimp names a node after each bone.
+void Mesh::processSkeleton(const aiScene *scene) {
+  std::vector<const aiBone *> bones;
+  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+    const aiMesh *mesh = scene->mMeshes[i];
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+      const aiBone *bone = mesh->mBones[b];
+      if (std::none_of(bones.begin(), bones.end(), [=](const aiBone *other) {
+            return other->mName == bone->mName;
+          })) {
+        bones.push_back(bone);
+      }
+    }
+  }
+  if (bones.empty()) {
+    return;
+  }
+  if (bones.size() > Skeleton::MAX_BONES) {
+    throw LoadError(std::to_string(bones.size()) + " bones, at most " +
+                    std::to_string(Skeleton::MAX_BONES) + " are supported");
+  }
+
+  // Joints are the bone nodes and their ancestors, parents first.
+  std::unordered_set<const aiNode *> joints;
+  for (const aiBone *bone : bones) {
+    const aiNode *node = scene->mRootNode->FindNode(bone->mName);
+    if (!node) {
+      throw LoadError(std::string("No node for bone ") +
+                      bone->mName.C_Str());
+    }
+    for (; node && joints.insert(node).second; node = node->mParent) {
+    }
+  }
+  std::vector<std::pair<const aiNode *, unsigned int>> stack;
+  stack.push_back({scene->mRootNode, Skeleton::NONE});
+  while (!stack.empty()) {
+    const aiNode *node = stack.back().first;
+    const unsigned int parent = stack.back().second;
+    stack.pop_back();
+    if (joints.count(node) == 0) {
+      continue;
+    }
+    const unsigned int joint =
+        static_cast<unsigned int>(MeshSkeleton.JointNames.size());
+    MeshSkeleton.JointNames.push_back(node->mName.C_Str());
+    MeshSkeleton.Parents.push_back(parent);
+    MeshSkeleton.BindTransforms.push_back(toMat4(node->mTransformation));
+    for (unsigned int i = node->mNumChildren; i-- > 0;) {
+      stack.push_back({node->mChildren[i], joint});
+    }
+  }
+  for (const aiBone *bone : bones) {
+    MeshSkeleton.BoneJoints.push_back(
+        MeshSkeleton.findJoint(bone->mName.C_Str()));
+    MeshSkeleton.InverseBindMatrices.push_back(toMat4(bone->mOffsetMatrix));
+  }
+  BonesLoaded = true;
+}
+
+// Renormalized so that the four bytes sum to exactly 255; the rounding error
+// goes to the largest weight.
+static glm::u8vec4 quantizeWeights(const glm::vec4 &weights) {
+  const float total = weights.x + weights.y + weights.z + weights.w;
+  if (total <= 0.0f) {
+    return glm::u8vec4(0);
+  }
+  glm::u8vec4 quantized;
+  int sum = 0;
+  int largest = 0;
+  for (int k = 0; k < 4; k++) {
+    quantized[k] = static_cast<uint8_t>(std::lround(weights[k] / total * 255));
+    sum += quantized[k];
+    if (weights[k] > weights[largest]) {
+      largest = k;
+    }
+  }
+  quantized[largest] = static_cast<uint8_t>(quantized[largest] + 255 - sum);
+  return quantized;
+}
+
+// Vertices keep their four largest influences.
+void Mesh::processBones(const aiMesh *mesh, std::size_t base) {
+  const unsigned int n = mesh->mNumVertices;
+  std::vector<glm::vec4> weights(n, glm::vec4(0.0f));
+  for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+    const aiBone *bone = mesh->mBones[b];
+    const unsigned int joint = MeshSkeleton.findJoint(bone->mName.C_Str());
+    const uint8_t index = static_cast<uint8_t>(
+        std::find(MeshSkeleton.BoneJoints.begin(),
+                  MeshSkeleton.BoneJoints.end(), joint) -
+        MeshSkeleton.BoneJoints.begin());
+    for (unsigned int i = 0; i < bone->mNumWeights; i++) {
+      const unsigned int v = bone->mWeights[i].mVertexId;
+      const float weight = bone->mWeights[i].mWeight;
+      glm::vec4 &kept = weights[v];
+      int smallest = 0;
+      for (int k = 1; k < 4; k++) {
+        if (kept[k] < kept[smallest]) {
+          smallest = k;
+        }
+      }
+      if (weight > kept[smallest]) {
+        kept[smallest] = weight;
+        BoneIndices[base + v][smallest] = index;
+      }
+    }
+  }
+  for (unsigned int v = 0; v < n; v++) {
+    BoneWeights[base + v] = quantizeWeights(weights[v]);
+  }
+}
+
+// Bind transform split into translation, rotation and scale, for channels
+// that lack keys of one kind.
+static void decompose(const glm::mat4 &m, glm::vec3 &translation,
+                      glm::quat &rotation, glm::vec3 &scale) {
+  translation = glm::vec3(m[3]);
+  scale = glm::vec3(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])),
+                    glm::length(glm::vec3(m[2])));
+  const glm::mat3 r(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y,
+                    glm::vec3(m[2]) / scale.z);
+  rotation = glm::quat_cast(r);
+}
+
+// Only channels of joints are kept, as nothing else is posed by a palette.
+// Times are converted from ticks to seconds.
+void Mesh::processAnimations(const aiScene *scene) {
+  if (!BonesLoaded) {
+    return;
+  }
+  Clips.resize(scene->mNumAnimations);
+  for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+    const aiAnimation *animation = scene->mAnimations[a];
+    AnimationClip &clip = Clips[a];
+    const double ticks =
+        animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+    clip.Name = animation->mName.C_Str();
+    clip.Duration = static_cast<float>(animation->mDuration / ticks);
+    for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+      const aiNodeAnim *node = animation->mChannels[c];
+      const unsigned int joint =
+          MeshSkeleton.findJoint(node->mNodeName.C_Str());
+      if (joint == Skeleton::NONE) {
+        continue;
+      }
+      AnimationChannel channel;
+      channel.Joint = joint;
+      for (unsigned int k = 0; k < node->mNumPositionKeys; k++) {
+        const aiVectorKey &key = node->mPositionKeys[k];
+        channel.PositionTimes.push_back(static_cast<float>(key.mTime / ticks));
+        channel.Positions.push_back(
+            glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+      }
+      for (unsigned int k = 0; k < node->mNumRotationKeys; k++) {
+        const aiQuatKey &key = node->mRotationKeys[k];
+        channel.RotationTimes.push_back(static_cast<float>(key.mTime / ticks));
+        channel.Rotations.push_back(
+            glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+      }
+      for (unsigned int k = 0; k < node->mNumScalingKeys; k++) {
+        const aiVectorKey &key = node->mScalingKeys[k];
+        channel.ScaleTimes.push_back(static_cast<float>(key.mTime / ticks));
+        channel.Scales.push_back(
+            glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+      }
+      glm::vec3 translation, scale;
+      glm::quat rotation;
+      decompose(MeshSkeleton.BindTransforms[joint], translation, rotation,
+                scale);
+      if (channel.Positions.empty()) {
+        channel.PositionTimes.push_back(0.0f);
+        channel.Positions.push_back(translation);
+      }
+      if (channel.Rotations.empty()) {
+        channel.RotationTimes.push_back(0.0f);
+        channel.Rotations.push_back(rotation);
+      }
+      if (channel.Scales.empty()) {
+        channel.ScaleTimes.push_back(0.0f);
+        channel.Scales.push_back(scale);
+      }
+      clip.Channels.push_back(std::move(channel));
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////// MORPH TARGET IMPORT
+
+// Assimp gives the targets of a shape per submesh. Submeshes share them by
+// name, and unnamed targets by their position.
+static std::string targetName(const aiAnimMesh *target, unsigned int i) {
+  return target->mName.length > 0 ? target->mName.C_Str() : std::to_string(i);
+}
+
+void Mesh::processMorphTargets(const aiScene *scene) {
+  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+    const aiMesh *mesh = scene->mMeshes[i];
+    for (unsigned int t = 0; t < mesh->mNumAnimMeshes; t++) {
+      const aiAnimMesh *target = mesh->mAnimMeshes[t];
+      const std::string name = targetName(target, t);
+      if (Morphs.findTarget(name) == MorphTargets::NONE) {
+        Morphs.Names.push_back(name);
+        Morphs.Weights.push_back(target->mWeight);
+      }
+    }
+  }
+  if (Morphs.getTargetCount() > MorphTargets::MAX_TARGETS) {
+    throw LoadError(std::to_string(Morphs.getTargetCount()) +
+                    " morph targets, at most " +
+                    std::to_string(MorphTargets::MAX_TARGETS) +
+                    " are supported");
+  }
+}
+
+// Targets hold whole vertices; only the differences from the base vertex
+// that are not zero are kept, which is what makes them sparse. Submeshes
+// without targets still get an empty range per vertex.
+void Mesh::processMorphs(const aiMesh *mesh) {
+  std::vector<unsigned int> targets(mesh->mNumAnimMeshes);
+  for (unsigned int t = 0; t < mesh->mNumAnimMeshes; t++) {
+    targets[t] = Morphs.findTarget(targetName(mesh->mAnimMeshes[t], t));
+  }
+  for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+    for (unsigned int t = 0; t < mesh->mNumAnimMeshes; t++) {
+      const aiAnimMesh *target = mesh->mAnimMeshes[t];
+      glm::vec3 position(0.0f);
+      glm::vec3 normal(0.0f);
+      if (target->mVertices) {
+        const aiVector3D d = target->mVertices[v] - mesh->mVertices[v];
+        position = glm::vec3(d.x, d.y, d.z);
+      }
+      if (target->mNormals && mesh->mNormals) {
+        const aiVector3D d = target->mNormals[v] - mesh->mNormals[v];
+        normal = glm::vec3(d.x, d.y, d.z);
+      }
+      if (position != glm::vec3(0.0f) || normal != glm::vec3(0.0f)) {
+        Morphs.addDelta(targets[t], position, normal);
+      }
+    }
+    Morphs.endVertex();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Files without a hierarchy, or whose hierarchy places every submesh once
+// and untransformed, are drawn with a single model matrix.
+void Mesh::finishDrawRecords() {
+  if (DrawRecords.empty()) {
+    for (unsigned int i = 0; i < Meshes.size(); i++) {
+      DrawRecords.push_back({i, glm::mat4(1.0f)});
+    }
+  }
+  FlatHierarchy = DrawRecords.size() == Meshes.size();
+  for (std::size_t i = 0; FlatHierarchy && i < DrawRecords.size(); i++) {
+    FlatHierarchy = DrawRecords[i].Submesh == i &&
+                    DrawRecords[i].Transform == glm::mat4(1.0f);
+  }
 }
 
 void Mesh::processScene(const aiScene *scene) {
@@ -108,8 +1161,10 @@ void Mesh::processScene(const aiScene *scene) {
   for (unsigned int i = 0; i < Meshes.size(); i++) {
     // Assuming all mesh faces are triangles
     Meshes[i].nIndices = scene->mMeshes[i]->mNumFaces * 3;
+    Meshes[i].nVertices = scene->mMeshes[i]->mNumVertices;
     Meshes[i].baseVertex = n_vertices;
     Meshes[i].baseIndex = n_indices;
+    Meshes[i].material = scene->mMeshes[i]->mMaterialIndex;
 
     n_vertices += scene->mMeshes[i]->mNumVertices;
     n_indices += Meshes[i].nIndices;
@@ -117,28 +1172,149 @@ void Mesh::processScene(const aiScene *scene) {
   Positions.reserve(n_vertices);
   Normals.reserve(n_vertices);
   Texcoords.reserve(n_vertices);
+  if (AssimpFlags & aiProcess_CalcTangentSpace) {
+    Tangents.reserve(n_vertices);
+#ifdef CREATE_BITANGENT
+    Bitangents.reserve(n_vertices);
+#endif
+  }
   Indices.reserve(n_indices);
+  // Vertices of meshes without bones keep zero weights, and are not skinned.
+  processSkeleton(scene);
+  if (BonesLoaded) {
+    BoneIndices.assign(n_vertices, glm::u8vec4(0));
+    BoneWeights.assign(n_vertices, glm::u8vec4(0));
+  }
+  processMorphTargets(scene);
+  if (!Morphs.empty()) {
+    Morphs.Offsets.reserve(n_vertices + 1);
+  }
 
   for (unsigned int i = 0; i < Meshes.size(); i++) {
     processMesh(scene->mMeshes[i]);
   }
+  processMaterials(scene);
+  processAnimations(scene);
+  processNodes(scene->mRootNode);
+  // Skinned vertices are placed by their palette, which already holds the
+  // transforms of the nodes.
+  for (DrawRecord &record : DrawRecords) {
+    if (scene->mMeshes[record.Submesh]->HasBones()) {
+      record.Transform = glm::mat4(1.0f);
+    }
+  }
+  finishDrawRecords();
 
 #ifdef DEBUG
   std::cout << "Loaded " << Meshes.size() << " mesh(es) [" << n_vertices
             << " vertices, " << n_indices << " indices, " << n_indices / 3
-            << " triangles]" << std::endl;
+            << " triangles, " << DrawRecords.size() << " draw records]"
+            << std::endl;
 #endif
 }
 
-void Mesh::create(const std::string &filename) {
+// OBJ files are read by ObjReader when the requested post-processing steps
+// are those it implements. It always triangulates and joins vertices, so it
+// is only used when both are asked for, the join possibly as a weld, and
+// Assimp keeps the meshes that must stay as they are in the file.
+bool Mesh::canLoadNatively(const std::string &filename) const {
+  const unsigned int supported = aiProcess_Triangulate |
+                                 aiProcess_JoinIdenticalVertices |
+                                 aiProcess_FlipUVs;
+  const bool joined = Weld || (AssimpFlags & aiProcess_JoinIdenticalVertices);
+  return NativeReaders && (AssimpFlags & aiProcess_Triangulate) && joined &&
+         (AssimpFlags & ~supported) == 0 && ObjReader::canRead(filename);
+}
+
+void Mesh::loadObj(const std::string &filename) {
+  ObjReader reader;
+  reader.setThreads(LoadThreads);
+  if (AssimpFlags & aiProcess_FlipUVs) {
+    reader.flipUVs();
+  }
+  ObjData data;
+  reader.read(filename, data);
+
+  Positions.swap(data.positions);
+  Normals.swap(data.normals);
+  Texcoords.swap(data.texcoords);
+  Indices.swap(data.indices);
+  NormalsLoaded = !Normals.empty();
+  TexcoordsLoaded = !Texcoords.empty();
+  TangentsAndBitangentsLoaded = false;
+  // As Assimp's OBJ importer does, a default material comes first, for
+  // submeshes without one, and the materials of the file follow it.
+  data.materials.insert(data.materials.begin(), ObjMaterial());
+  Materials.resize(data.materials.size());
+  for (std::size_t i = 0; i < Materials.size(); i++) {
+    const ObjMaterial &material = data.materials[i];
+    Materials[i].Diffuse = glm::vec4(material.diffuse, material.opacity);
+    Materials[i].Specular = glm::vec4(material.specular, material.shininess);
+    Materials[i].Ambient = glm::vec4(material.ambient, 0.0f);
+    Materials[i].Emissive = glm::vec4(material.emissive, 0.0f);
+  }
+  Meshes.resize(data.submeshes.size());
+  for (std::size_t i = 0; i < Meshes.size(); i++) {
+    Meshes[i].nIndices = data.submeshes[i].nIndices;
+    Meshes[i].nVertices = data.submeshes[i].nVertices;
+    Meshes[i].baseIndex = data.submeshes[i].baseIndex;
+    Meshes[i].baseVertex = data.submeshes[i].baseVertex;
+    Meshes[i].material =
+        static_cast<unsigned int>(data.submeshes[i].material + 1);
+  }
+  finishDrawRecords();
+
+#ifdef DEBUG
+  std::cout << "Loaded " << Meshes.size() << " mesh(es) [" << Positions.size()
+            << " vertices, " << Indices.size() << " indices, "
+            << Indices.size() / 3 << " triangles]" << std::endl;
+#endif
+}
+
+// Parses the file into CPU-side streams. Does not touch GL, so it may run on
+// a worker thread. Throws LoadError rather than exiting if the file cannot be
+// read.
+void Mesh::load(const std::string &filename) {
   clear();
+  if (isBakedFile(filename)) {
+    loadBaked(filename);
+    return;
+  }
+  if (canLoadNatively(filename)) {
+#ifdef DEBUG
+    std::cout << "Processing [" << filename << "]" << std::endl;
+#endif
+    loadObj(filename);
+  } else {
+    loadScene(filename);
+  }
+  if (Weld) {
+    weld();
+  }
+  if (NativeTangents) {
+    computeTangents();
+  }
+  if (OptimizeCache) {
+    optimizeIndices();
+  }
+  computeBounds();
+  if (LodLevels > 0) {
+    computeLods();
+  }
+  VertexCount = Positions.size();
+}
+
+void Mesh::loadScene(const std::string &filename) {
   Assimp::Importer importer;
+  // Files in mounted packs, and those they reference, are read from memory.
+  if (!AssetPacks::getInstance().empty()) {
+    importer.SetIOHandler(new PackIOSystem());
+  }
   const aiScene *scene = importer.ReadFile(filename, AssimpFlags);
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) {
-    std::cerr << "Error while loading:" << importer.GetErrorString()
-              << std::endl;
-    exit(EXIT_FAILURE);
+    throw LoadError("Cannot load " + filename + ": " +
+                    importer.GetErrorString());
   }
 
 #ifdef DEBUG
@@ -146,87 +1322,498 @@ void Mesh::create(const std::string &filename) {
 #endif
 
   processScene(scene);
-  createBufferObjects();
 }
 
-void Mesh::createBufferObjects() {
-  GLuint boId[6];
+//////////////////////////////////////////////////////////////////// BAKED FILES
+//
+// A mesh is baked once every load step has run, with its vertices packed in
+// its layout, so that loading it is a copy out of a mapped file. Layouts are
+// stored by name, and must be one of those declared with Mesh. Baked meshes
+// have no CPU streams: vertices only exist packed, up to their upload.
+
+struct BakedLayout {
+  const char *name;
+  const VertexLayout &(*layout)();
+};
 
-  glGenVertexArrays(1, &VaoId);
-  glBindVertexArray(VaoId);
-  {
-    glGenBuffers(6, boId);
+static const BakedLayout BAKED_LAYOUTS[] = {
+    {"PositionVertex", &PositionVertex::layout},
+    {"PositionNormalVertex", &PositionNormalVertex::layout},
+    {"PositionTexcoordVertex", &PositionTexcoordVertex::layout},
+    {"PositionNormalTexcoordVertex", &PositionNormalTexcoordVertex::layout},
+    {"TangentSpaceVertex", &TangentSpaceVertex::layout},
+    {"PackedTangentSpaceVertex", &PackedTangentSpaceVertex::layout},
+    {"SkinnedVertex", &SkinnedVertex::layout},
+    {"CompactVertex", &CompactVertex::layout}};
 
-    glBindBuffer(GL_ARRAY_BUFFER, boId[POSITION]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(),
-                 &Positions[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(POSITION);
-    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+static const uint32_t BAKED_NORMALS = 1 << 0;
+static const uint32_t BAKED_TEXCOORDS = 1 << 1;
+static const uint32_t BAKED_TANGENTS = 1 << 2;
+static const uint32_t BAKED_BONES = 1 << 3;
 
-    if (NormalsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[NORMAL]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(),
-                   &Normals[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(NORMAL);
-      glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
+static void writeSkeleton(BakedWriter &out, const Skeleton &skeleton) {
+  out.write(skeleton.JointNames);
+  out.write(skeleton.Parents);
+  out.write(skeleton.BindTransforms);
+  out.write(skeleton.BoneJoints);
+  out.write(skeleton.InverseBindMatrices);
+}
+
+static void readSkeleton(BakedReader &in, Skeleton &skeleton) {
+  in.read(skeleton.JointNames);
+  in.read(skeleton.Parents);
+  in.read(skeleton.BindTransforms);
+  in.read(skeleton.BoneJoints);
+  in.read(skeleton.InverseBindMatrices);
+}
+
+static void writeClips(BakedWriter &out,
+                       const std::vector<AnimationClip> &clips) {
+  out.write(static_cast<uint32_t>(clips.size()));
+  for (const AnimationClip &clip : clips) {
+    out.write(clip.Name);
+    out.write(clip.Duration);
+    out.write(static_cast<uint32_t>(clip.Channels.size()));
+    for (const AnimationChannel &channel : clip.Channels) {
+      out.write(channel.Joint);
+      out.write(channel.PositionTimes);
+      out.write(channel.Positions);
+      out.write(channel.RotationTimes);
+      out.write(channel.Rotations);
+      out.write(channel.ScaleTimes);
+      out.write(channel.Scales);
     }
+  }
+}
 
-    if (TexcoordsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[TEXCOORD]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Texcoords[0]) * Texcoords.size(),
-                   &Texcoords[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(TEXCOORD);
-      glVertexAttribPointer(TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
+static void readClips(BakedReader &in, std::vector<AnimationClip> &clips) {
+  uint32_t count;
+  in.read(count);
+  clips.resize(count);
+  for (AnimationClip &clip : clips) {
+    in.read(clip.Name);
+    in.read(clip.Duration);
+    in.read(count);
+    clip.Channels.resize(count);
+    for (AnimationChannel &channel : clip.Channels) {
+      in.read(channel.Joint);
+      in.read(channel.PositionTimes);
+      in.read(channel.Positions);
+      in.read(channel.RotationTimes);
+      in.read(channel.Rotations);
+      in.read(channel.ScaleTimes);
+      in.read(channel.Scales);
     }
+  }
+}
+
+static void writeMorphs(BakedWriter &out, const MorphTargets &morphs) {
+  out.write(morphs.Names);
+  out.write(morphs.Weights);
+  out.write(morphs.Offsets);
+  out.write(morphs.Deltas);
+}
+
+static void readMorphs(BakedReader &in, MorphTargets &morphs) {
+  in.read(morphs.Names);
+  in.read(morphs.Weights);
+  in.read(morphs.Offsets);
+  in.read(morphs.Deltas);
+}
+
+// Must be called after load() and before the mesh is uploaded, while its
+// streams are still in memory.
+void Mesh::save(const std::string &filename) const {
+  const VertexLayout &layout = getVertexLayout();
+  const BakedLayout *baked = std::find_if(
+      std::begin(BAKED_LAYOUTS), std::end(BAKED_LAYOUTS),
+      [&](const BakedLayout &named) { return &named.layout() == &layout; });
+  if (baked == std::end(BAKED_LAYOUTS)) {
+    std::cerr << "[ERROR] Cannot bake " << filename
+              << ": its vertex layout is not one declared with Mesh"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  uint32_t flags = 0;
+  flags |= NormalsLoaded ? BAKED_NORMALS : 0;
+  flags |= TexcoordsLoaded ? BAKED_TEXCOORDS : 0;
+  flags |= TangentsAndBitangentsLoaded ? BAKED_TANGENTS : 0;
+  flags |= BonesLoaded ? BAKED_BONES : 0;
+
+  BakedWriter out(filename);
+  out.write(std::string(baked->name));
+  out.write(flags);
+  out.write(VertexData.empty() ? packVertices() : VertexData);
+  out.write(Indices);
+  out.write(Meshes);
+  out.write(Lods);
+  out.write(DrawRecords);
+  out.write(Materials);
+  out.write(MeshBounds);
+  writeSkeleton(out, MeshSkeleton);
+  writeClips(out, Clips);
+  writeMorphs(out, Morphs);
+  out.close();
+}
+
+// The file's layout replaces any set with setVertexLayout(), as the vertices
+// are already packed in it.
+void Mesh::loadBaked(const std::string &filename) {
+  BakedReader in(filename);
+  std::string name;
+  in.read(name);
+  const BakedLayout *baked = std::find_if(
+      std::begin(BAKED_LAYOUTS), std::end(BAKED_LAYOUTS),
+      [&](const BakedLayout &named) { return name == named.name; });
+  if (baked == std::end(BAKED_LAYOUTS)) {
+    throw LoadError("Unknown vertex layout " + name + " in " + filename);
+  }
+  Layout = &baked->layout();
+  uint32_t flags;
+  in.read(flags);
+  NormalsLoaded = (flags & BAKED_NORMALS) != 0;
+  TexcoordsLoaded = (flags & BAKED_TEXCOORDS) != 0;
+  TangentsAndBitangentsLoaded = (flags & BAKED_TANGENTS) != 0;
+  BonesLoaded = (flags & BAKED_BONES) != 0;
+  in.read(VertexData);
+  in.read(Indices);
+  in.read(Meshes);
+  in.read(Lods);
+  in.read(DrawRecords);
+  in.read(Materials);
+  in.read(MeshBounds);
+  readSkeleton(in, MeshSkeleton);
+  readClips(in, Clips);
+  readMorphs(in, Morphs);
+  VertexCount = VertexData.size() / Layout->Stride;
+  finishDrawRecords();
 
-    if (TangentsAndBitangentsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[TANGENT]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Tangents[0]) * Tangents.size(),
-                   &Tangents[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(TANGENT);
-      glVertexAttribPointer(TANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+#ifdef DEBUG
+  std::cout << "Loaded baked [" << filename << "] " << Meshes.size()
+            << " mesh(es) [" << VertexCount << " vertices, " << Indices.size()
+            << " indices, " << getLodCount() << " levels of detail]"
+            << std::endl;
+#endif
+}
+
+// Creates the GL objects from the loaded streams, on the render thread. The
+// buffers may already have been created by the loader's upload context, in
+// which case only the vertex array is left to create.
+void Mesh::upload() {
+  if (VertexBufferId == 0) {
+    createBuffers();
+  }
+  createVertexArray();
+  GpuBytes = getUploadSize();
+  releaseCpuData();
+  Ready = true;
+  Pending = false;
+}
 
+std::size_t Mesh::getUploadSize() const {
+  return getVertexLayout().Stride * VertexCount +
+         sizeof(Indices[0]) * Indices.size();
+}
+
+bool Mesh::isReady() const { return Ready; }
+
+template <typename T> static std::size_t bytes(const std::vector<T> &v) {
+  return sizeof(T) * v.capacity();
+}
+
+template <typename T> static void release(std::vector<T> &v) {
+  std::vector<T>().swap(v);
+}
+
+void Mesh::releaseCpuData() {
+  release(VertexData);
+  if (RetentionPolicy == KEEP_ALL) {
+    return;
+  }
+  release(Normals);
+  release(Texcoords);
+  release(Tangents);
 #ifdef CREATE_BITANGENT
-      glBindBuffer(GL_ARRAY_BUFFER, boId[BITANGENT]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Bitangents[0]) * Bitangents.size(),
-                   &Bitangents[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(BITANGENT);
-      glVertexAttribPointer(BITANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  release(Bitangents);
 #endif
-    }
+  release(BoneIndices);
+  release(BoneWeights);
+  release(WeldRemap);
+  if (RetentionPolicy == KEEP_NONE) {
+    release(Positions);
+    release(Indices);
+  }
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boId[INDEX]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(),
-                 &Indices[0], GL_STATIC_DRAW);
+std::size_t Mesh::MemoryReport::getCpuBytes() const {
+  return Positions + Normals + Texcoords + Tangents + Bitangents + Bones +
+         Indices + Submeshes + Materials + Remap + Animation + Morphs;
+}
+
+Mesh::MemoryReport Mesh::getMemoryReport() const {
+  MemoryReport report;
+  report.Positions = bytes(Positions);
+  report.Normals = bytes(Normals);
+  report.Texcoords = bytes(Texcoords);
+  report.Tangents = bytes(Tangents);
+#ifdef CREATE_BITANGENT
+  report.Bitangents = bytes(Bitangents);
+#endif
+  report.Bones = bytes(BoneIndices) + bytes(BoneWeights);
+  report.Indices = bytes(Indices);
+  report.Submeshes = bytes(Meshes) + bytes(DrawRecords);
+  report.Materials = bytes(Materials);
+  report.Remap = bytes(WeldRemap);
+  report.Animation = MeshSkeleton.getCpuBytes() + bytes(Clips);
+  for (const AnimationClip &clip : Clips) {
+    report.Animation += clip.getCpuBytes();
   }
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glDeleteBuffers(6, boId);
+  report.Morphs = Morphs.getCpuBytes();
+  report.Gpu = GpuBytes;
+  return report;
 }
 
-void Mesh::destroyBufferObjects() {
-  glBindVertexArray(VaoId);
-  glDisableVertexAttribArray(POSITION);
-  glDisableVertexAttribArray(NORMAL);
-  glDisableVertexAttribArray(TEXCOORD);
-  glDisableVertexAttribArray(TANGENT);
+void Mesh::printMemoryReport(std::ostream &out) const {
+  const MemoryReport report = getMemoryReport();
+  out << "CPU " << report.getCpuBytes() << " bytes [positions "
+      << report.Positions << ", normals " << report.Normals << ", texcoords "
+      << report.Texcoords << ", tangents " << report.Tangents
+      << ", bitangents " << report.Bitangents << ", bones " << report.Bones
+      << ", indices " << report.Indices << ", submeshes " << report.Submeshes
+      << ", materials " << report.Materials << ", remap " << report.Remap
+      << ", animation " << report.Animation << ", morphs " << report.Morphs
+      << "], GPU " << report.Gpu << " bytes" << std::endl;
+}
+
+std::size_t Mesh::getCpuBytes() const {
+  return getMemoryReport().getCpuBytes();
+}
+
+std::size_t Mesh::getGpuBytes() const { return GpuBytes; }
+
+void Mesh::create(const std::string &filename) {
+  try {
+    load(filename);
+  } catch (const LoadError &error) {
+    std::cerr << "[ERROR] " << error.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  upload();
+}
+
+// Returns immediately; the mesh is not drawn until isReady(). Must be called
+// from the render thread, which uploads the mesh in MeshLoader::upload().
+void Mesh::createAsync(const std::string &filename) {
+  if (Pending) {
+    MeshLoader::getInstance().cancel(this);
+  }
+  if (Ready) {
+    destroyBufferObjects();
+    Ready = false;
+    GpuBytes = 0;
+  }
+  Pending = true;
+  MeshLoader::getInstance().load(this, filename);
+}
+
+// Vertices are interleaved into a single buffer by the vertex layout. With
+// direct state access (GL 4.5), buffers get immutable storage and the vertex
+// array is described without binding anything. The bind-to-edit path is kept
+// for older contexts. Buffers are shared between contexts but vertex arrays
+// are not, so they are created in two steps.
+
+static bool hasDirectStateAccess() {
+  return GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+}
+
+// Streams are only handed to the layout if they cover every vertex.
+VertexSource Mesh::getVertexSource() const {
+  VertexSource source;
+  const std::size_t n = Positions.size();
+  if (n == 0) {
+    return source;
+  }
+  source.set(Semantic::POSITION, &Positions[0].x);
+  if (Normals.size() == n) {
+    source.set(Semantic::NORMAL, &Normals[0].x);
+  }
+  if (Texcoords.size() == n) {
+    source.set(Semantic::TEXCOORD, &Texcoords[0].x);
+  }
+  if (Tangents.size() == n) {
+    source.set(Semantic::TANGENT, &Tangents[0].x);
+  }
 #ifdef CREATE_BITANGENT
-  glDisableVertexAttribArray(BITANGENT);
+  if (Bitangents.size() == n) {
+    source.set(Semantic::BITANGENT, &Bitangents[0].x);
+  }
 #endif
-  glDeleteVertexArrays(1, &VaoId);
-  glBindVertexArray(0);
+  if (BoneIndices.size() == n) {
+    source.setPacked(Semantic::BONES, &BoneIndices[0].x);
+    source.setPacked(Semantic::WEIGHTS, &BoneWeights[0].x);
+  }
+  return source;
+}
+
+// Needs a current context, but not the render thread's.
+std::vector<unsigned char> Mesh::packVertices() const {
+  const VertexLayout &layout = getVertexLayout();
+  std::vector<unsigned char> vertices(layout.Stride * Positions.size());
+  layout.pack(getVertexSource(), Positions.size(), vertices.data());
+  return vertices;
+}
+
+// Baked meshes come with their vertices already packed.
+void Mesh::createBuffers() {
+  if (VertexData.empty()) {
+    VertexData = packVertices();
+  }
+  const std::vector<unsigned char> &vertices = VertexData;
+  const GLsizeiptr indices_size = sizeof(Indices[0]) * Indices.size();
+
+  if (hasDirectStateAccess()) {
+    glCreateBuffers(1, &VertexBufferId);
+    glNamedBufferStorage(VertexBufferId, vertices.size(), vertices.data(), 0);
+    glCreateBuffers(1, &IndexBufferId);
+    glNamedBufferStorage(IndexBufferId, indices_size, Indices.data(), 0);
+  } else {
+    // Index data goes through the array buffer target, as binding the element
+    // array buffer needs a vertex array.
+    StateCache &state = StateCache::getInstance();
+    glGenBuffers(1, &VertexBufferId);
+    state.bindBuffer(GL_ARRAY_BUFFER, VertexBufferId);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(),
+                 GL_STATIC_DRAW);
+    glGenBuffers(1, &IndexBufferId);
+    state.bindBuffer(GL_ARRAY_BUFFER, IndexBufferId);
+    glBufferData(GL_ARRAY_BUFFER, indices_size, Indices.data(),
+                 GL_STATIC_DRAW);
+    state.bindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+}
+
+void Mesh::createVertexArray() {
+  const VertexLayout &layout = getVertexLayout();
+  if (hasDirectStateAccess()) {
+    glCreateVertexArrays(1, &VaoId);
+    layout.setupVertexArray(VaoId, VertexBufferId);
+    glVertexArrayElementBuffer(VaoId, IndexBufferId);
+  } else {
+    StateCache &state = StateCache::getInstance();
+    glGenVertexArrays(1, &VaoId);
+    state.bindVertexArray(VaoId);
+    state.bindBuffer(GL_ARRAY_BUFFER, VertexBufferId);
+    layout.setupBoundVertexArray();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBufferId);
+    state.bindVertexArray(0);
+    state.bindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  // The vertex array keeps the buffers alive until it is deleted.
+  releaseBuffers();
+}
+
+void Mesh::releaseBuffers() {
+  if (VertexBufferId != 0) {
+    StateCache::getInstance().deleteBuffer(VertexBufferId);
+    VertexBufferId = 0;
+  }
+  if (IndexBufferId != 0) {
+    StateCache::getInstance().deleteBuffer(IndexBufferId);
+    IndexBufferId = 0;
+  }
+}
+
+// Deletion is deferred until the GPU has finished the frames using the mesh.
+void Mesh::destroyBufferObjects() {
+  DeletionQueue &deletion = DeletionQueue::getInstance();
+  if (Ready) {
+    deletion.deleteVertexArray(VaoId);
+  }
+  if (VertexBufferId != 0) {
+    deletion.deleteBuffer(VertexBufferId);
+    VertexBufferId = 0;
+  }
+  if (IndexBufferId != 0) {
+    deletion.deleteBuffer(IndexBufferId);
+    IndexBufferId = 0;
+  }
+}
+
+void Mesh::bind() { StateCache::getInstance().bindVertexArray(VaoId); }
+
+void Mesh::unbind() { StateCache::getInstance().bindVertexArray(0); }
+
+static bool hasBaseInstance() {
+  return GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
 }
 
+// The material index is the base instance of a single instance draw, read as
+// gl_BaseInstance by the shaders. Without GL 4.2 it is always 0.
+static void drawSubmesh(unsigned int nIndices, unsigned int baseIndex,
+                        unsigned int baseVertex, unsigned int material) {
+  void *indices = reinterpret_cast<void *>(sizeof(unsigned int) * baseIndex);
+  if (hasBaseInstance()) {
+    glDrawElementsInstancedBaseVertexBaseInstance(
+        GL_TRIANGLES, nIndices, GL_UNSIGNED_INT, indices, 1, baseVertex,
+        material);
+  } else {
+    glDrawElementsBaseVertex(GL_TRIANGLES, nIndices, GL_UNSIGNED_INT, indices,
+                             baseVertex);
+  }
+}
+
+// Levels of detail share the vertices and materials of level 0.
+const Mesh::MeshData &Mesh::getSubmesh(std::size_t i) const {
+  return Lod == 0 ? Meshes[i] : Lods[(Lod - 1) * Meshes.size() + i];
+}
+
+// Applies to the draws that follow, until changed.
+void Mesh::setLod(unsigned int level) {
+  if (level >= getLodCount()) {
+    std::cerr << "[ERROR] Invalid level of detail " << level << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Lod = level;
+}
+
+// Draws every submesh once, ignoring the node hierarchy. Material indices
+// are offset by materialBase, where the mesh's materials start in the table.
+// With oneMaterial, every submesh is drawn with material materialBase itself.
+void Mesh::drawElements(unsigned int materialBase, bool oneMaterial) {
+  for (std::size_t i = 0; i < Meshes.size(); i++) {
+    const MeshData &mesh = getSubmesh(i);
+    drawSubmesh(mesh.nIndices, mesh.baseIndex, mesh.baseVertex,
+                oneMaterial ? materialBase : materialBase + mesh.material);
+  }
+}
+
+// Draws every draw record, each with the model matrix composed with its
+// transform.
+void Mesh::drawElements(GLint modelMatrixId, const glm::mat4 &modelMatrix,
+                        unsigned int materialBase, bool oneMaterial) {
+  if (FlatHierarchy) {
+    glUniformMatrix4fv(modelMatrixId, 1, GL_FALSE,
+                       glm::value_ptr(modelMatrix));
+    drawElements(materialBase, oneMaterial);
+    return;
+  }
+  for (const DrawRecord &record : DrawRecords) {
+    const MeshData &mesh = getSubmesh(record.Submesh);
+    const glm::mat4 matrix = modelMatrix * record.Transform;
+    glUniformMatrix4fv(modelMatrixId, 1, GL_FALSE, glm::value_ptr(matrix));
+    drawSubmesh(mesh.nIndices, mesh.baseIndex, mesh.baseVertex,
+                oneMaterial ? materialBase : materialBase + mesh.material);
+  }
+}
+
+// The vertex array is left bound; the state cache makes a following bind of
+// the same mesh free.
 void Mesh::draw() {
-  glBindVertexArray(VaoId);
-  for (MeshData &mesh : Meshes) {
-    glDrawElementsBaseVertex(
-        GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT,
-        reinterpret_cast<void *>((sizeof(unsigned int) * mesh.baseIndex)),
-        mesh.baseVertex);
-    // GLenum mode, GLsizei count, GLenum type, void *indices, GLint basevertex
+  if (!Ready) {
+    return;
   }
-  glBindVertexArray(0);
+  bind();
+  drawElements();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
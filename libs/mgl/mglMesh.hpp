@@ -14,30 +14,123 @@
 #include <assimp/scene.h>
 
 #include <assimp/Importer.hpp>
+#include <glm/ext/vector_uint4_sized.hpp>
 #include <glm/glm.hpp>
+#include <ostream>
 #include <string>
 #include <vector>
 
+#include "./mglMaterials.hpp"
+#include "./mglMorph.hpp"
 #include "./mglScenegraph.hpp"
+#include "./mglSkeleton.hpp"
+#include "./mglVertexFormat.hpp"
 
 namespace mgl {
 
 class Mesh;
+struct Bounds;
 
 #define CREATE_BITANGENT
 
+////////////////////////////////////////////////////////////////// VertexFormats
+//
+// Formats picked by default from the streams a file provides. Custom formats,
+// such as CompactVertex, are selected with Mesh::setVertexLayout().
+
+using PositionVertex = VertexFormat<Attribute<Semantic::POSITION, float, 3>>;
+using PositionNormalVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::NORMAL, float, 3>>;
+using PositionTexcoordVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::TEXCOORD, float, 2>>;
+using PositionNormalTexcoordVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::NORMAL, float, 3>,
+                 Attribute<Semantic::TEXCOORD, float, 2>>;
+using TangentSpaceVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::NORMAL, float, 3>,
+                 Attribute<Semantic::TEXCOORD, float, 2>,
+                 Attribute<Semantic::TANGENT, float, 3>
+#ifdef CREATE_BITANGENT
+                 ,
+                 Attribute<Semantic::BITANGENT, float, 3>
+#endif
+                 >;
+// 48 bytes instead of 56: the bitangent is w * cross(normal, tangent.xyz).
+using PackedTangentSpaceVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::NORMAL, float, 3>,
+                 Attribute<Semantic::TEXCOORD, float, 2>,
+                 Attribute<Semantic::TANGENT, float, 4>>;
+// Up to four bones per vertex: uint8 indices and unorm8 weights summing to 1.
+using SkinnedVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::NORMAL, float, 3>,
+                 Attribute<Semantic::TEXCOORD, float, 2>,
+                 Attribute<Semantic::BONES, uint8_t, 4>,
+                 Attribute<Semantic::WEIGHTS, uint8_t, 4, true>>;
+// 20 bytes instead of 32: snorm8 normal (padded to 4) and half texcoords.
+using CompactVertex =
+    VertexFormat<Attribute<Semantic::POSITION, float, 3>,
+                 Attribute<Semantic::NORMAL, int8_t, 4, true>,
+                 Attribute<Semantic::TEXCOORD, Half, 2>>;
+
+///////////////////////////////////////////////////////////////////////// Bounds
+
+struct Bounds {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+  glm::vec3 center = glm::vec3(0.0f);
+  float radius = 0.0f;
+};
+
 /////////////////////////////////////////////////////////////////////////// Mesh
 
 class Mesh : public IDrawable {
 public:
   static const GLuint INDEX = 0;
-  static const GLuint POSITION = 1;
-  static const GLuint NORMAL = 2;
-  static const GLuint TEXCOORD = 3;
-  static const GLuint TANGENT = 4;
+  static const GLuint POSITION = static_cast<GLuint>(Semantic::POSITION);
+  static const GLuint NORMAL = static_cast<GLuint>(Semantic::NORMAL);
+  static const GLuint TEXCOORD = static_cast<GLuint>(Semantic::TEXCOORD);
+  static const GLuint TANGENT = static_cast<GLuint>(Semantic::TANGENT);
 #ifdef CREATE_BITANGENT
-  static const GLuint BITANGENT = 5;
+  static const GLuint BITANGENT = static_cast<GLuint>(Semantic::BITANGENT);
 #endif
+  static const GLuint BONES = static_cast<GLuint>(Semantic::BONES);
+  static const GLuint WEIGHTS = static_cast<GLuint>(Semantic::WEIGHTS);
+  static const float DEFAULT_WELD_EPSILON;
+  static const unsigned int LOD_RESOLUTION;
+
+  // What stays in CPU memory once the mesh is on the GPU.
+  enum Retention { KEEP_NONE, KEEP_POSITIONS_AND_INDICES, KEEP_ALL };
+
+  // A submesh as placed by the file's node hierarchy, relative to the mesh.
+  // A submesh referenced by several nodes is stored once and has a record
+  // per reference.
+  struct DrawRecord {
+    unsigned int Submesh;
+    glm::mat4 Transform;
+  };
+
+  struct MemoryReport {
+    std::size_t Positions = 0;
+    std::size_t Normals = 0;
+    std::size_t Texcoords = 0;
+    std::size_t Tangents = 0;
+    std::size_t Bitangents = 0;
+    std::size_t Bones = 0;
+    std::size_t Indices = 0;
+    std::size_t Submeshes = 0;
+    std::size_t Materials = 0;
+    std::size_t Remap = 0;
+    std::size_t Animation = 0;
+    std::size_t Morphs = 0;
+    std::size_t Gpu = 0;
+    std::size_t getCpuBytes() const;
+  };
 
   Mesh();
   ~Mesh();
@@ -54,40 +147,138 @@ public:
   void generateSmoothNormals();
   void generateTexcoords();
   void calculateTangentSpace();
+  void generateTangents(bool packed = false);
   void flipUVs();
+  void useNativeReaders(bool native);
+  void weldVertices(float epsilon = DEFAULT_WELD_EPSILON);
+  void optimizeVertexCache();
+  void generateLods(unsigned int levels);
+  void setLoadThreads(unsigned int threads);
+  void setVertexLayout(const VertexLayout &layout);
+  void setRetention(Retention retention);
 
   void create(const std::string &filename);
+  void createAsync(const std::string &filename);
+  void load(const std::string &filename);
+  void save(const std::string &filename) const;
+  void createBuffers();
+  void upload();
+  std::size_t getUploadSize() const;
+  std::size_t getCpuBytes() const;
+  std::size_t getGpuBytes() const;
+  MemoryReport getMemoryReport() const;
+  void printMemoryReport(std::ostream &out) const;
+  bool isReady() const;
   void draw() override;
+  void bind();
+  void setLod(unsigned int level);
+  void drawElements(unsigned int materialBase = 0, bool oneMaterial = false);
+  void drawElements(GLint modelMatrixId, const glm::mat4 &modelMatrix,
+                    unsigned int materialBase = 0, bool oneMaterial = false);
+  void unbind();
 
   bool hasNormals();
   bool hasTexcoords();
   bool hasTangentsAndBitangents();
+  bool hasBones();
+  bool hasMorphTargets();
+  const Bounds &getBounds() const;
+  std::size_t getVertexCount() const;
+  std::size_t getTriangleCount(unsigned int level = 0) const;
+  unsigned int getLodCount() const;
+  float getCacheMissRatio(unsigned int level = 0) const;
+  const std::vector<DrawRecord> &getDrawRecords() const;
+  const std::vector<MaterialData> &getMaterials() const;
+  const Skeleton &getSkeleton() const;
+  const std::vector<AnimationClip> &getAnimationClips() const;
+  const MorphTargets &getMorphTargets() const;
+  const std::vector<glm::vec3> &getPositions() const;
+  const std::vector<glm::vec3> &getNormals() const;
+  const std::vector<unsigned int> &getIndices() const;
+  const std::vector<glm::u8vec4> &getBoneIndices() const;
+  const std::vector<glm::u8vec4> &getBoneWeights() const;
+  const VertexLayout &getVertexLayout() const;
+  const std::vector<unsigned int> &getWeldRemap() const;
+  unsigned int getVertexFormat() const;
 
 private:
   GLuint VaoId;
+  GLuint VertexBufferId, IndexBufferId;
   unsigned int AssimpFlags;
   bool NormalsLoaded, TexcoordsLoaded, TangentsAndBitangentsLoaded;
+  bool BonesLoaded;
+  const VertexLayout *Layout;
+  bool Ready, Pending;
+  std::size_t GpuBytes;
+  Retention RetentionPolicy;
+  bool NativeReaders;
+  unsigned int LoadThreads;
+  bool Weld;
+  float WeldEpsilon;
+  bool NativeTangents, PackedTangents;
+  bool OptimizeCache;
+  unsigned int LodLevels;
+  unsigned int Lod;
 
   struct MeshData {
     unsigned int nIndices = 0;
+    unsigned int nVertices = 0;
     unsigned int baseIndex = 0;
     unsigned int baseVertex = 0;
+    unsigned int material = 0;
+    Bounds bounds;
   };
   std::vector<MeshData> Meshes;
+  // Per level of detail after the first, a range per submesh.
+  std::vector<MeshData> Lods;
+  std::vector<DrawRecord> DrawRecords;
+  std::vector<MaterialData> Materials;
+  bool FlatHierarchy;
+  Bounds MeshBounds;
 
   std::vector<glm::vec3> Positions;
   std::vector<glm::vec3> Normals;
   std::vector<glm::vec2> Texcoords;
-  std::vector<glm::vec3> Tangents;
+  std::vector<glm::vec4> Tangents;
 #ifdef CREATE_BITANGENT
   std::vector<glm::vec3> Bitangents;
 #endif
+  std::vector<glm::u8vec4> BoneIndices;
+  std::vector<glm::u8vec4> BoneWeights;
   std::vector<unsigned int> Indices;
+  std::vector<unsigned char> VertexData;
+  std::size_t VertexCount;
+  std::vector<unsigned int> WeldRemap;
+  Skeleton MeshSkeleton;
+  std::vector<AnimationClip> Clips;
+  MorphTargets Morphs;
 
   void clear();
   void processScene(const aiScene *scene);
   void processMesh(const aiMesh *mesh);
-  void createBufferObjects();
+  void processBones(const aiMesh *mesh, std::size_t base);
+  void processSkeleton(const aiScene *scene);
+  void processAnimations(const aiScene *scene);
+  void processMorphTargets(const aiScene *scene);
+  void processMorphs(const aiMesh *mesh);
+  void processMaterials(const aiScene *scene);
+  void processNodes(const aiNode *root);
+  void finishDrawRecords();
+  bool canLoadNatively(const std::string &filename) const;
+  void loadObj(const std::string &filename);
+  void loadScene(const std::string &filename);
+  void loadBaked(const std::string &filename);
+  void weld();
+  void computeTangents();
+  void computeBounds();
+  void optimizeIndices();
+  void computeLods();
+  const MeshData &getSubmesh(std::size_t i) const;
+  std::vector<unsigned char> packVertices() const;
+  VertexSource getVertexSource() const;
+  void createVertexArray();
+  void releaseBuffers();
+  void releaseCpuData();
   void destroyBufferObjects();
 };
 
@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Morph Targets
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMorph.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include <iostream>
+
+#include "./mglApp.hpp"
+#include "./mglDeletionQueue.hpp"
+#include "./mglRing.hpp"
+#include "./mglState.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// MorphDelta
+
+unsigned int MorphDelta::getTarget() const { return TargetNormalZ & 0xFFFF; }
+
+glm::vec3 MorphDelta::getNormal() const {
+  return glm::vec3(glm::unpackHalf2x16(NormalXY),
+                   glm::unpackHalf1x16(static_cast<uint16_t>(
+                       TargetNormalZ >> 16)));
+}
+
+/////////////////////////////////////////////////////////////////// MorphTargets
+
+const unsigned int MorphTargets::NONE;
+const unsigned int MorphTargets::MAX_TARGETS;
+
+template <typename T> static std::size_t bytes(const std::vector<T> &v) {
+  return sizeof(T) * v.capacity();
+}
+
+bool MorphTargets::empty() const { return Names.empty(); }
+
+std::size_t MorphTargets::getTargetCount() const { return Names.size(); }
+
+std::size_t MorphTargets::getVertexCount() const {
+  return Offsets.empty() ? 0 : Offsets.size() - 1;
+}
+
+unsigned int MorphTargets::findTarget(const std::string &name) const {
+  for (std::size_t i = 0; i < Names.size(); i++) {
+    if (Names[i] == name) {
+      return static_cast<unsigned int>(i);
+    }
+  }
+  return NONE;
+}
+
+void MorphTargets::addDelta(unsigned int target, const glm::vec3 &position,
+                            const glm::vec3 &normal) {
+  if (Offsets.empty()) {
+    Offsets.push_back(0);
+  }
+  MorphDelta delta;
+  delta.Position = position;
+  delta.NormalXY = glm::packHalf2x16(glm::vec2(normal));
+  delta.TargetNormalZ =
+      (target & 0xFFFF) |
+      static_cast<uint32_t>(glm::packHalf1x16(normal.z)) << 16;
+  Deltas.push_back(delta);
+}
+
+void MorphTargets::endVertex() {
+  if (Offsets.empty()) {
+    Offsets.push_back(0);
+  }
+  Offsets.push_back(static_cast<unsigned int>(Deltas.size()));
+}
+
+void MorphTargets::apply(const float *weights, const glm::vec3 *positions,
+                         const glm::vec3 *normals, glm::vec3 *outPositions,
+                         glm::vec3 *outNormals) const {
+  const std::size_t n = getVertexCount();
+  for (std::size_t v = 0; v < n; v++) {
+    glm::vec3 position = positions[v];
+    glm::vec3 normal = normals ? normals[v] : glm::vec3(0.0f);
+    for (unsigned int i = Offsets[v]; i < Offsets[v + 1]; i++) {
+      const MorphDelta &delta = Deltas[i];
+      const float weight = weights[delta.getTarget()];
+      position += weight * delta.Position;
+      normal += weight * delta.getNormal();
+    }
+    outPositions[v] = position;
+    if (normals && outNormals) {
+      outNormals[v] = glm::normalize(normal);
+    }
+  }
+}
+
+std::size_t MorphTargets::getCpuBytes() const {
+  std::size_t names = bytes(Names);
+  for (const std::string &name : Names) {
+    names += name.capacity();
+  }
+  return names + bytes(Weights) + bytes(Offsets) + bytes(Deltas);
+}
+
+//////////////////////////////////////////////////////////////////// MorphBuffer
+
+const std::size_t MorphBuffer::MIN_CAPACITY;
+
+MorphBuffer::MorphBuffer(GLuint morphbindingpoint, GLuint weightbindingpoint) {
+  MorphBindingPoint = morphbindingpoint;
+  WeightBindingPoint = weightbindingpoint;
+  Capacity = 0;
+  DirtyBegin = 0;
+  DirtyEnd = 0;
+  DirectStateAccess = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+  if (DirectStateAccess) {
+    glCreateBuffers(1, &MorphsId);
+  } else {
+    glGenBuffers(1, &MorphsId);
+  }
+}
+
+MorphBuffer::~MorphBuffer() {
+  DeletionQueue::getInstance().deleteBuffer(MorphsId);
+}
+
+// The offsets of a vertex are rebased to word indices of its deltas, so a
+// shader needs no other per-mesh value than the returned base.
+unsigned int MorphBuffer::addTargets(const MorphTargets &targets) {
+  const std::size_t base = Words.size();
+  const std::size_t n = targets.getVertexCount();
+  const std::size_t deltas = base + n + 1;
+  const std::size_t words = sizeof(MorphDelta) / sizeof(uint32_t);
+  Words.resize(deltas + words * targets.Deltas.size());
+  for (std::size_t v = 0; v <= n; v++) {
+    const std::size_t offset = n > 0 ? targets.Offsets[v] : 0;
+    Words[base + v] = static_cast<uint32_t>(deltas + words * offset);
+  }
+  if (!targets.Deltas.empty()) {
+    std::memcpy(&Words[deltas], targets.Deltas.data(),
+                sizeof(MorphDelta) * targets.Deltas.size());
+  }
+  if (DirtyBegin == DirtyEnd) {
+    DirtyBegin = base;
+  }
+  DirtyEnd = Words.size();
+  return static_cast<unsigned int>(base);
+}
+
+unsigned int MorphBuffer::addWeights(const MorphTargets &targets) {
+  const std::size_t base = Weights.size();
+  Weights.insert(Weights.end(), targets.Weights.begin(),
+                 targets.Weights.end());
+  return static_cast<unsigned int>(base);
+}
+
+void MorphBuffer::setWeight(unsigned int base, unsigned int target,
+                            float weight) {
+  if (std::size_t(base) + target >= Weights.size()) {
+    std::cerr << "[ERROR] Invalid morph weight " << base << "+" << target
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Weights[base + target] = weight;
+}
+
+float MorphBuffer::getWeight(unsigned int base, unsigned int target) const {
+  if (std::size_t(base) + target >= Weights.size()) {
+    std::cerr << "[ERROR] Invalid morph weight " << base << "+" << target
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return Weights[base + target];
+}
+
+std::size_t MorphBuffer::getGpuBytes() const {
+  return sizeof(uint32_t) * Capacity;
+}
+
+// Targets grow as the material table does. Weights are streamed through the
+// upload ring, as skinning palettes are.
+void MorphBuffer::upload() {
+  StateCache &state = StateCache::getInstance();
+  if (DirtyBegin != DirtyEnd) {
+    if (Words.size() > Capacity) {
+      Capacity = std::max({Words.size(), 2 * Capacity, MIN_CAPACITY});
+      const GLsizeiptr bytes =
+          static_cast<GLsizeiptr>(sizeof(uint32_t) * Capacity);
+      if (DirectStateAccess) {
+        glNamedBufferData(MorphsId, bytes, nullptr, GL_STATIC_DRAW);
+      } else {
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, MorphsId);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+      }
+      DirtyBegin = 0;
+      DirtyEnd = Words.size();
+      state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, MorphBindingPoint,
+                           MorphsId);
+    }
+    const GLintptr offset =
+        static_cast<GLintptr>(sizeof(uint32_t) * DirtyBegin);
+    const GLsizeiptr bytes =
+        static_cast<GLsizeiptr>(sizeof(uint32_t) * (DirtyEnd - DirtyBegin));
+    if (DirectStateAccess) {
+      glNamedBufferSubData(MorphsId, offset, bytes, &Words[DirtyBegin]);
+    } else {
+      state.bindBuffer(GL_SHADER_STORAGE_BUFFER, MorphsId);
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, bytes,
+                      &Words[DirtyBegin]);
+    }
+    DirtyBegin = 0;
+    DirtyEnd = 0;
+  }
+  if (!Weights.empty()) {
+    UploadRing &ring = Engine::getInstance().getUploadRing();
+    const GLsizeiptr bytes =
+        static_cast<GLsizeiptr>(sizeof(float) * Weights.size());
+    const UploadRing::Region region = ring.write(Weights.data(), bytes);
+    ring.bindRange(GL_SHADER_STORAGE_BUFFER, WeightBindingPoint, region);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
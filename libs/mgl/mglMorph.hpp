@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Morph Targets
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MORPH_HPP
+#define MGL_MORPH_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+struct MorphDelta;
+struct MorphTargets;
+class MorphBuffer;
+
+///////////////////////////////////////////////////////////////////// MorphDelta
+//
+// How one target moves one vertex, in 20 bytes: the position offset in full
+// floats, and the normal offset as halves, the last one sharing a word with
+// the target index.
+
+struct MorphDelta {
+  glm::vec3 Position;
+  uint32_t NormalXY;
+  uint32_t TargetNormalZ;
+
+  unsigned int getTarget() const;
+  glm::vec3 getNormal() const;
+};
+
+static_assert(sizeof(MorphDelta) == 5 * sizeof(uint32_t),
+              "MorphDelta must be five words");
+
+/////////////////////////////////////////////////////////////////// MorphTargets
+//
+// The blend shapes of a mesh as sparse deltas from its base vertices, grouped
+// by vertex: the deltas of vertex v are Deltas[Offsets[v]] up to
+// Deltas[Offsets[v + 1]]. A vertex only pays for the targets that move it, so
+// a face with dozens of targets that each touch a small region stays small,
+// and a vertex shader loops over the few deltas of its vertex rather than
+// over every target. Targets are blended relatively: each adds its delta
+// scaled by its weight.
+
+struct MorphTargets {
+  static const unsigned int NONE = ~0u;
+  static const unsigned int MAX_TARGETS = 1 << 16;
+
+  std::vector<std::string> Names;
+  std::vector<float> Weights;
+  std::vector<unsigned int> Offsets;
+  std::vector<MorphDelta> Deltas;
+
+  bool empty() const;
+  std::size_t getTargetCount() const;
+  std::size_t getVertexCount() const;
+  unsigned int findTarget(const std::string &name) const;
+  // Deltas are added to the current vertex, which endVertex() closes.
+  void addDelta(unsigned int target, const glm::vec3 &position,
+                const glm::vec3 &normal);
+  void endVertex();
+  // Morphs every vertex on the CPU, with a weight per target. Normals are
+  // renormalized; either normal array may be null.
+  void apply(const float *weights, const glm::vec3 *positions,
+             const glm::vec3 *normals, glm::vec3 *outPositions,
+             glm::vec3 *outNormals) const;
+  std::size_t getCpuBytes() const;
+};
+
+//////////////////////////////////////////////////////////////////// MorphBuffer
+//
+// Morph targets of every mesh in a scene, in one shader storage buffer, and
+// the weights of every morphed instance in a second one. The targets are a
+// flat array of words: per mesh, an offset per vertex into the deltas that
+// follow it, so addTargets() returns where the offsets start and a vertex
+// shader finds those of a vertex at that base plus gl_VertexID. Instances
+// get a block of weights, one per target of their mesh, from addWeights().
+// Targets are sent once, as with materials, and stay in their own buffer.
+// Weights are edited every frame, so upload() writes all of them into a
+// region of the engine's upload ring and binds that range; it must be called
+// in every frame that draws morphed instances.
+
+class MorphBuffer {
+ public:
+  static const std::size_t MIN_CAPACITY = 1 << 12;
+
+  MorphBuffer(GLuint morphbindingpoint, GLuint weightbindingpoint);
+  ~MorphBuffer();
+  MorphBuffer(const MorphBuffer &) = delete;
+  MorphBuffer &operator=(const MorphBuffer &) = delete;
+
+  unsigned int addTargets(const MorphTargets &targets);
+  // Starts from the default weights of the targets.
+  unsigned int addWeights(const MorphTargets &targets);
+  void setWeight(unsigned int base, unsigned int target, float weight);
+  float getWeight(unsigned int base, unsigned int target) const;
+  void upload();
+  std::size_t getGpuBytes() const;
+
+ private:
+  GLuint MorphsId;
+  GLuint MorphBindingPoint, WeightBindingPoint;
+  bool DirectStateAccess;
+  std::size_t Capacity;
+  std::size_t DirtyBegin, DirtyEnd;
+  std::vector<uint32_t> Words;
+  std::vector<float> Weights;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_MORPH_HPP */
@@ -0,0 +1,836 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Wavefront OBJ/MTL Reader
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglObj.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "./mglPack.hpp"
+#include "./mglParallel.hpp"
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace mgl {
+
+////////////////////////////////////////////////////////////////// LINE SCANNING
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+static unsigned int countTrailingZeros(unsigned int mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// Compares 16 bytes at a time against '\n'.
+static const char *findLineEnd(const char *p, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    if (mask) {
+      return p + countTrailingZeros(mask);
+    }
+    p += 16;
+  }
+  const void *found = std::memchr(p, '\n', end - p);
+  return found ? static_cast<const char *>(found) : end;
+}
+
+#else
+
+static const char *findLineEnd(const char *p, const char *end) {
+  const void *found = std::memchr(p, '\n', end - p);
+  return found ? static_cast<const char *>(found) : end;
+}
+
+#endif
+
+static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+static bool isDigit(char c) { return static_cast<unsigned>(c - '0') < 10; }
+
+static bool startsWith(const char *p, const char *end, const char *keyword) {
+  const std::size_t n = std::strlen(keyword);
+  return static_cast<std::size_t>(end - p) > n &&
+         std::memcmp(p, keyword, n) == 0 && isBlank(p[n]);
+}
+
+static std::string readName(const char *p, const char *end) {
+  p = skipBlanks(p, end);
+  while (end > p && isBlank(end[-1])) {
+    end--;
+  }
+  return std::string(p, end);
+}
+
+///////////////////////////////////////////////////////////////// NUMBER PARSING
+
+// Up to 19 significant digits are accumulated in an integer and scaled once
+// by an exactly representable power of ten. Returns p if there is no number.
+
+static const double POWERS_OF_TEN[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const char *parseFloat(const char *p, const char *end, float &value) {
+  p = skipBlanks(p, end);
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; p < end && isDigit(*p); p++) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0 ? 1 : 0;
+    } else {
+      exponent++;
+    }
+    any = true;
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && isDigit(*p); p++) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0 ? 1 : 0;
+        exponent--;
+      }
+      any = true;
+    }
+  }
+  if (!any) {
+    value = 0.0f;
+    return start;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negative_exponent = *q == '-';
+      q++;
+    }
+    if (q < end && isDigit(*q)) {
+      int e = 0;
+      for (; q < end && isDigit(*q); q++) {
+        e = e < 10000 ? e * 10 + (*q - '0') : e;
+      }
+      exponent += negative_exponent ? -e : e;
+      p = q;
+    }
+  }
+  double result = static_cast<double>(mantissa);
+  if (exponent < 0) {
+    result = exponent >= -22 ? result / POWERS_OF_TEN[-exponent]
+                             : result * std::pow(10.0, exponent);
+  } else if (exponent > 0) {
+    result = exponent <= 22 ? result * POWERS_OF_TEN[exponent]
+                            : result * std::pow(10.0, exponent);
+  }
+  value = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+static const char *parseVec3(const char *p, const char *end, glm::vec3 &v) {
+  p = parseFloat(p, end, v.x);
+  p = parseFloat(p, end, v.y);
+  return parseFloat(p, end, v.z);
+}
+
+static const char *parseInt(const char *p, const char *end, int &value) {
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || !isDigit(*p)) {
+    value = 0;
+    return start;
+  }
+  int result = 0;
+  for (; p < end && isDigit(*p); p++) {
+    result = result * 10 + (*p - '0');
+  }
+  value = negative ? -result : result;
+  return p;
+}
+
+// Reads a v[/vt][/vn] face corner, leaving 0 for the indices not given.
+// Returns p if there is no corner left on the line.
+static const char *parseCorner(const char *p, const char *end, int &v, int &t,
+                               int &n) {
+  const char *q = skipBlanks(p, end);
+  t = n = 0;
+  const char *next = parseInt(q, end, v);
+  if (next == q) {
+    return p;
+  }
+  if (next < end && *next == '/') {
+    next = parseInt(next + 1, end, t);
+    if (next < end && *next == '/') {
+      next = parseInt(next + 1, end, n);
+    }
+  }
+  return next;
+}
+
+/////////////////////////////////////////////////////////////////// VERTEX CACHE
+
+// Open addressing table from a submesh and v/vt/vn triple to the emitted
+// vertex. Slots of older generations are empty, so it resets in constant time.
+
+class VertexCache {
+ public:
+  void reset() {
+    Count = 0;
+    if (++Generation == 0) {
+      Slots.assign(Slots.size(), Slot());
+      Generation = 1;
+    }
+  }
+
+  // Returns whether the key is new, in which case it maps to candidate.
+  bool insert(unsigned int s, int v, int t, int n, unsigned int candidate,
+              unsigned int &index) {
+    if ((Count + 1) * 2 > Slots.size()) {
+      grow();
+    }
+    const std::size_t mask = Slots.size() - 1;
+    for (std::size_t i = hash(s, v, t, n) & mask;; i = (i + 1) & mask) {
+      Slot &slot = Slots[i];
+      if (slot.generation != Generation) {
+        slot = {s, v, t, n, Generation, candidate};
+        Count++;
+        index = candidate;
+        return true;
+      }
+      if (slot.v == v && slot.t == t && slot.n == n && slot.s == s) {
+        index = slot.index;
+        return false;
+      }
+    }
+  }
+
+  static uint64_t hash(unsigned int s, int v, int t, int n) {
+    uint64_t h = static_cast<uint32_t>(v) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint32_t>(t) * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+    h ^= static_cast<uint32_t>(n) * 0x165667B19E3779F9ull + (h >> 32);
+    h ^= static_cast<uint64_t>(s) * 0x27D4EB2F165667C5ull + (h >> 27);
+    return h ^ (h >> 31);
+  }
+
+ private:
+  struct Slot {
+    unsigned int s = 0;
+    int v = 0, t = 0, n = 0;
+    unsigned int generation = 0;
+    unsigned int index = 0;
+  };
+  std::vector<Slot> Slots;
+  std::size_t Count = 0;
+  unsigned int Generation = 1;
+
+  void grow() {
+    std::vector<Slot> old;
+    old.swap(Slots);
+    Slots.resize(old.empty() ? 1024 : old.size() * 2);
+    const std::size_t mask = Slots.size() - 1;
+    for (const Slot &slot : old) {
+      if (slot.generation != Generation) {
+        continue;
+      }
+      std::size_t i = hash(slot.s, slot.v, slot.t, slot.n) & mask;
+      while (Slots[i].generation == Generation) {
+        i = (i + 1) & mask;
+      }
+      Slots[i] = slot;
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////// FILE CHUNKS
+//
+// Each chunk is parsed into its own v/vt/vn pools. Negative face indices are
+// resolved against the chunk pools, so they stay relative to the chunk until
+// the pool sizes of the earlier chunks are known. Corners are fan triangulated
+// and welded within the chunk; ObjReader::readParallel merges the chunks.
+
+static const int NO_INDEX = std::numeric_limits<int>::min();
+static const unsigned char RELATIVE_V = 1, RELATIVE_T = 2, RELATIVE_N = 4;
+
+struct ObjCorner {
+  int v, t, n;
+  unsigned char relative;
+};
+
+// Objects, groups and material changes start a submesh; material libraries
+// are read in file order, after the chunks are parsed.
+struct ObjEvent {
+  std::size_t corner;
+  char kind;
+  std::string name;
+};
+
+struct ObjVertexKey {
+  unsigned int s;
+  int v, t, n;
+};
+
+struct ObjChunk {
+  const char *begin = nullptr;
+  const char *end = nullptr;
+  std::vector<glm::vec3> v, vn;
+  std::vector<glm::vec2> vt;
+  std::vector<ObjCorner> corners;
+  std::vector<ObjEvent> events;
+  bool hasNormals = false, hasTexcoords = false;
+
+  std::size_t vOffset = 0, vtOffset = 0, vnOffset = 0;
+  std::size_t cornerOffset = 0, uniqueOffset = 0, vertexOffset = 0;
+  unsigned int firstSubmesh = 0;
+  std::size_t nVertices = 0;
+
+  std::vector<ObjVertexKey> uniques;
+  std::vector<unsigned int> cornerUniques;
+  std::vector<std::vector<unsigned int>> partitions;
+  std::vector<unsigned int> submeshCorners, submeshVertices;
+};
+
+static int chunkIndex(int index, std::size_t count, unsigned char flag,
+                      unsigned char &relative) {
+  if (index >= 0) {
+    return index - 1;
+  }
+  relative |= flag;
+  return index + static_cast<int>(count);
+}
+
+static void parseChunk(ObjChunk &chunk, bool flip_uvs) {
+  std::vector<ObjCorner> polygon;
+  const char *p = chunk.begin;
+  while (p < chunk.end) {
+    const char *eol = findLineEnd(p, chunk.end);
+    const char *line = skipBlanks(p, eol);
+    p = eol + 1;
+    if (eol - line < 2) {
+      continue;
+    }
+    if (line[0] == 'v' && isBlank(line[1])) {
+      glm::vec3 position;
+      parseVec3(line + 1, eol, position);
+      chunk.v.push_back(position);
+    } else if (line[0] == 'v' && line[1] == 't') {
+      glm::vec2 texcoord;
+      parseFloat(parseFloat(line + 2, eol, texcoord.x), eol, texcoord.y);
+      if (flip_uvs) {
+        texcoord.y = 1.0f - texcoord.y;
+      }
+      chunk.vt.push_back(texcoord);
+    } else if (line[0] == 'v' && line[1] == 'n') {
+      glm::vec3 normal;
+      parseVec3(line + 2, eol, normal);
+      chunk.vn.push_back(normal);
+    } else if (line[0] == 'f' && isBlank(line[1])) {
+      polygon.clear();
+      const char *q = line + 1;
+      for (;;) {
+        int iv, it, in;
+        const char *next = parseCorner(q, eol, iv, it, in);
+        if (next == q) {
+          break;
+        }
+        q = next;
+        ObjCorner corner;
+        corner.relative = 0;
+        corner.v = chunkIndex(iv, chunk.v.size(), RELATIVE_V, corner.relative);
+        corner.t = it ? chunkIndex(it, chunk.vt.size(), RELATIVE_T,
+                                   corner.relative)
+                      : NO_INDEX;
+        corner.n = in ? chunkIndex(in, chunk.vn.size(), RELATIVE_N,
+                                   corner.relative)
+                      : NO_INDEX;
+        polygon.push_back(corner);
+      }
+      for (std::size_t i = 2; i < polygon.size(); i++) {
+        chunk.corners.push_back(polygon[0]);
+        chunk.corners.push_back(polygon[i - 1]);
+        chunk.corners.push_back(polygon[i]);
+      }
+    } else if ((line[0] == 'o' || line[0] == 'g') && isBlank(line[1])) {
+      chunk.events.push_back({chunk.corners.size(), 'o', std::string()});
+    } else if (startsWith(line, eol, "usemtl")) {
+      chunk.events.push_back(
+          {chunk.corners.size(), 'u', readName(line + 6, eol)});
+    } else if (startsWith(line, eol, "mtllib")) {
+      chunk.events.push_back(
+          {chunk.corners.size(), 'm', readName(line + 6, eol)});
+    }
+  }
+}
+
+// Resolves the corners to indices into the merged pools and emits each
+// submesh/v/vt/vn key of the chunk once. Keys are spread over the partitions
+// of the merge by hash.
+static void weldChunk(ObjChunk &chunk, const std::size_t counts[3],
+                      std::size_t n_partitions, const std::string &filename) {
+  auto resolve = [&filename](int index, bool relative, std::size_t offset,
+                             std::size_t count) {
+    const long long i = relative ? index + (long long)offset : index;
+    if (i < 0 || i >= (long long)count) {
+      throw LoadError(filename + " has a face index out of range");
+    }
+    return static_cast<int>(i);
+  };
+
+  VertexCache cache;
+  std::size_t n_submeshes = 1;
+  for (const ObjEvent &event : chunk.events) {
+    n_submeshes += event.kind != 'm' ? 1 : 0;
+  }
+  chunk.submeshCorners.assign(n_submeshes, 0);
+  chunk.submeshVertices.assign(n_submeshes, 0);
+  chunk.partitions.assign(n_partitions, std::vector<unsigned int>());
+  chunk.cornerUniques.resize(chunk.corners.size());
+
+  unsigned int s = chunk.firstSubmesh;
+  std::size_t e = 0;
+  for (std::size_t i = 0; i < chunk.corners.size(); i++) {
+    for (; e < chunk.events.size() && chunk.events[e].corner <= i; e++) {
+      if (chunk.events[e].kind != 'm') {
+        s++;
+        cache.reset();
+      }
+    }
+    const ObjCorner &corner = chunk.corners[i];
+    const int v = resolve(corner.v, corner.relative & RELATIVE_V,
+                          chunk.vOffset, counts[0]);
+    const int t = corner.t == NO_INDEX
+                      ? -1
+                      : resolve(corner.t, corner.relative & RELATIVE_T,
+                                chunk.vtOffset, counts[1]);
+    const int n = corner.n == NO_INDEX
+                      ? -1
+                      : resolve(corner.n, corner.relative & RELATIVE_N,
+                                chunk.vnOffset, counts[2]);
+    chunk.hasTexcoords |= t >= 0;
+    chunk.hasNormals |= n >= 0;
+    const unsigned int candidate =
+        static_cast<unsigned int>(chunk.uniques.size());
+    unsigned int index;
+    if (cache.insert(s, v, t, n, candidate, index)) {
+      chunk.uniques.push_back({s, v, t, n});
+      const uint64_t h = VertexCache::hash(s, v, t, n);
+      chunk.partitions[(h >> 40) % n_partitions].push_back(candidate);
+    }
+    chunk.cornerUniques[i] = index;
+    chunk.submeshCorners[s - chunk.firstSubmesh]++;
+  }
+  std::vector<ObjCorner>().swap(chunk.corners);
+}
+
+////////////////////////////////////////////////////////////////////// ObjReader
+
+const std::size_t ObjReader::MIN_CHUNK_SIZE;
+
+ObjReader::ObjReader() {
+  FlipUVs = false;
+  Threads = 1;
+}
+
+void ObjReader::flipUVs() { FlipUVs = true; }
+
+void ObjReader::setThreads(unsigned int threads) { Threads = threads; }
+
+bool ObjReader::canRead(const std::string &filename) {
+  const std::size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos || filename.size() - dot != 4) {
+    return false;
+  }
+  const char *ext = filename.c_str() + dot + 1;
+  return (ext[0] | 0x20) == 'o' && (ext[1] | 0x20) == 'b' &&
+         (ext[2] | 0x20) == 'j';
+}
+
+static int findMaterial(ObjData &data, const std::string &name) {
+  for (std::size_t i = 0; i < data.materials.size(); i++) {
+    if (data.materials[i].name == name) {
+      return static_cast<int>(i);
+    }
+  }
+  data.materials.push_back(ObjMaterial());
+  data.materials.back().name = name;
+  return static_cast<int>(data.materials.size() - 1);
+}
+
+static std::string directoryOf(const std::string &filename) {
+  const std::size_t slash = filename.find_last_of("/\\");
+  return slash == std::string::npos ? std::string()
+                                    : filename.substr(0, slash + 1);
+}
+
+// A missing material library is not fatal: its materials keep defaults.
+void ObjReader::readMaterials(const std::string &filename, ObjData &data) {
+  AssetFile file;
+  if (!file.open(filename)) {
+    std::cerr << "[WARNING] Material library " << filename << " not found"
+              << std::endl;
+    return;
+  }
+  ObjMaterial *material = nullptr;
+  const char *p = file.data();
+  const char *end = p + file.size();
+  while (p < end) {
+    const char *eol = findLineEnd(p, end);
+    const char *line = skipBlanks(p, eol);
+    p = eol + 1;
+    if (startsWith(line, eol, "newmtl")) {
+      material = &data.materials[findMaterial(data, readName(line + 6, eol))];
+    } else if (!material) {
+      continue;
+    } else if (startsWith(line, eol, "Ka")) {
+      parseVec3(line + 2, eol, material->ambient);
+    } else if (startsWith(line, eol, "Kd")) {
+      parseVec3(line + 2, eol, material->diffuse);
+    } else if (startsWith(line, eol, "Ks")) {
+      parseVec3(line + 2, eol, material->specular);
+    } else if (startsWith(line, eol, "Ke")) {
+      parseVec3(line + 2, eol, material->emissive);
+    } else if (startsWith(line, eol, "Ns")) {
+      parseFloat(line + 2, eol, material->shininess);
+    } else if (startsWith(line, eol, "d")) {
+      parseFloat(line + 1, eol, material->opacity);
+    } else if (startsWith(line, eol, "Tr")) {
+      float transparency = 0.0f;
+      parseFloat(line + 2, eol, transparency);
+      material->opacity = 1.0f - transparency;
+    } else if (startsWith(line, eol, "map_Kd")) {
+      material->diffuseMap = readName(line + 6, eol);
+    }
+  }
+}
+
+void ObjReader::read(const std::string &filename, ObjData &data) {
+  AssetFile file;
+  if (!file.open(filename)) {
+    throw LoadError(filename + " cannot be opened");
+  }
+  data = ObjData();
+  const std::size_t threads = resolveThreads(Threads);
+  const std::size_t chunks = std::min(threads, file.size() / MIN_CHUNK_SIZE);
+  const char *p = file.data();
+  if (chunks > 1) {
+    readParallel(p, p + file.size(), chunks, filename, data);
+  } else {
+    readSequential(p, p + file.size(), filename, data);
+  }
+}
+
+void ObjReader::readSequential(const char *p, const char *end,
+                               const std::string &filename, ObjData &data) {
+  std::vector<glm::vec3> v, vn;
+  std::vector<glm::vec2> vt;
+  VertexCache cache;
+  std::vector<unsigned int> corners;
+  bool has_normals = false, has_texcoords = false;
+  int material = -1;
+
+  auto finishSubmesh = [&data]() {
+    ObjSubmesh &submesh = data.submeshes.back();
+    submesh.nIndices =
+        static_cast<unsigned int>(data.indices.size()) - submesh.baseIndex;
+    submesh.nVertices =
+        static_cast<unsigned int>(data.positions.size()) - submesh.baseVertex;
+  };
+  auto startSubmesh = [&]() {
+    if (!data.submeshes.empty()) {
+      finishSubmesh();
+      if (data.submeshes.back().nIndices == 0) {
+        data.submeshes.back().material = material;
+        return;
+      }
+    }
+    ObjSubmesh submesh;
+    submesh.baseIndex = static_cast<unsigned int>(data.indices.size());
+    submesh.baseVertex = static_cast<unsigned int>(data.positions.size());
+    submesh.material = material;
+    data.submeshes.push_back(submesh);
+    cache.reset();
+  };
+  auto resolve = [&filename](int index, std::size_t count) {
+    const long long i = index > 0 ? index - 1 : index + (long long)count;
+    if (index == 0 || i < 0 || i >= (long long)count) {
+      throw LoadError(filename + " has a face index out of range");
+    }
+    return static_cast<std::size_t>(i);
+  };
+
+  startSubmesh();
+  while (p < end) {
+    const char *eol = findLineEnd(p, end);
+    const char *line = skipBlanks(p, eol);
+    p = eol + 1;
+    if (eol - line < 2) {
+      continue;
+    }
+    if (line[0] == 'v' && isBlank(line[1])) {
+      glm::vec3 position;
+      parseVec3(line + 1, eol, position);
+      v.push_back(position);
+    } else if (line[0] == 'v' && line[1] == 't') {
+      glm::vec2 texcoord;
+      parseFloat(parseFloat(line + 2, eol, texcoord.x), eol, texcoord.y);
+      if (FlipUVs) {
+        texcoord.y = 1.0f - texcoord.y;
+      }
+      vt.push_back(texcoord);
+    } else if (line[0] == 'v' && line[1] == 'n') {
+      glm::vec3 normal;
+      parseVec3(line + 2, eol, normal);
+      vn.push_back(normal);
+    } else if (line[0] == 'f' && isBlank(line[1])) {
+      corners.clear();
+      const char *q = line + 1;
+      for (;;) {
+        int iv, it, in;
+        const char *next = parseCorner(q, eol, iv, it, in);
+        if (next == q) {
+          break;
+        }
+        q = next;
+        const std::size_t pi = resolve(iv, v.size());
+        const std::size_t ti = it ? resolve(it, vt.size()) : 0;
+        const std::size_t ni = in ? resolve(in, vn.size()) : 0;
+        const unsigned int candidate = static_cast<unsigned int>(
+            data.positions.size() - data.submeshes.back().baseVertex);
+        unsigned int index;
+        if (cache.insert(0, static_cast<int>(pi),
+                         it ? static_cast<int>(ti) : -1,
+                         in ? static_cast<int>(ni) : -1, candidate, index)) {
+          data.positions.push_back(v[pi]);
+          data.texcoords.push_back(it ? vt[ti] : glm::vec2(0.0f));
+          data.normals.push_back(in ? vn[ni] : glm::vec3(0.0f));
+          has_texcoords |= it != 0;
+          has_normals |= in != 0;
+        }
+        corners.push_back(index);
+      }
+      // Fan triangulation, as for the convex polygons exporters write.
+      for (std::size_t i = 2; i < corners.size(); i++) {
+        data.indices.push_back(corners[0]);
+        data.indices.push_back(corners[i - 1]);
+        data.indices.push_back(corners[i]);
+      }
+    } else if ((line[0] == 'o' || line[0] == 'g') && isBlank(line[1])) {
+      startSubmesh();
+    } else if (startsWith(line, eol, "usemtl")) {
+      material = findMaterial(data, readName(line + 6, eol));
+      startSubmesh();
+    } else if (startsWith(line, eol, "mtllib")) {
+      readMaterials(directoryOf(filename) + readName(line + 6, eol), data);
+    }
+  }
+  finishSubmesh();
+  if (data.submeshes.back().nIndices == 0) {
+    data.submeshes.pop_back();
+  }
+  if (!has_normals) {
+    std::vector<glm::vec3>().swap(data.normals);
+  }
+  if (!has_texcoords) {
+    std::vector<glm::vec2>().swap(data.texcoords);
+  }
+}
+
+// Chunks are parsed and welded in parallel. Vertices emitted by several
+// chunks are then merged by partition: the partitions are disjoint sets of
+// keys, and within each the first chunk to emit a key keeps the vertex.
+// Numbering the kept vertices in chunk order gives the vertex order of the
+// single threaded reader, with each submesh's vertices contiguous.
+void ObjReader::readParallel(const char *p, const char *end,
+                             std::size_t n_chunks, const std::string &filename,
+                             ObjData &data) {
+  std::vector<ObjChunk> chunks(n_chunks);
+  const std::size_t size = end - p;
+  const char *begin = p;
+  for (std::size_t i = 0; i < n_chunks; i++) {
+    const char *split = std::max(begin, p + size * (i + 1) / n_chunks);
+    const char *eol = findLineEnd(split, end);
+    chunks[i].begin = begin;
+    chunks[i].end = i + 1 < n_chunks && eol < end ? eol + 1 : end;
+    begin = chunks[i].end;
+  }
+  runParallel(n_chunks, [&chunks, this](std::size_t i) {
+    parseChunk(chunks[i], FlipUVs);
+  });
+
+  // Chunk offsets, and submesh materials in file order.
+  std::size_t counts[3] = {0, 0, 0};
+  std::size_t n_indices = 0;
+  std::vector<int> materials(1, -1);
+  int material = -1;
+  for (ObjChunk &chunk : chunks) {
+    chunk.vOffset = counts[0];
+    chunk.vtOffset = counts[1];
+    chunk.vnOffset = counts[2];
+    chunk.cornerOffset = n_indices;
+    chunk.firstSubmesh = static_cast<unsigned int>(materials.size() - 1);
+    counts[0] += chunk.v.size();
+    counts[1] += chunk.vt.size();
+    counts[2] += chunk.vn.size();
+    n_indices += chunk.corners.size();
+    for (const ObjEvent &event : chunk.events) {
+      if (event.kind == 'm') {
+        readMaterials(directoryOf(filename) + event.name, data);
+        continue;
+      }
+      if (event.kind == 'u') {
+        material = findMaterial(data, event.name);
+      }
+      materials.push_back(material);
+    }
+  }
+
+  std::vector<glm::vec3> v(counts[0]), vn(counts[2]);
+  std::vector<glm::vec2> vt(counts[1]);
+  runParallel(n_chunks, [&](std::size_t i) {
+    ObjChunk &chunk = chunks[i];
+    std::copy(chunk.v.begin(), chunk.v.end(), v.begin() + chunk.vOffset);
+    std::copy(chunk.vt.begin(), chunk.vt.end(), vt.begin() + chunk.vtOffset);
+    std::copy(chunk.vn.begin(), chunk.vn.end(), vn.begin() + chunk.vnOffset);
+    std::vector<glm::vec3>().swap(chunk.v);
+    std::vector<glm::vec2>().swap(chunk.vt);
+    std::vector<glm::vec3>().swap(chunk.vn);
+    weldChunk(chunk, counts, n_chunks, filename);
+  });
+
+  std::size_t n_uniques = 0;
+  bool has_normals = false, has_texcoords = false;
+  for (ObjChunk &chunk : chunks) {
+    chunk.uniqueOffset = n_uniques;
+    n_uniques += chunk.uniques.size();
+    has_normals |= chunk.hasNormals;
+    has_texcoords |= chunk.hasTexcoords;
+  }
+  std::vector<unsigned char> kept(n_uniques);
+  std::vector<unsigned int> vertices(n_uniques);
+  runParallel(n_chunks, [&](std::size_t partition) {
+    VertexCache cache;
+    for (const ObjChunk &chunk : chunks) {
+      for (unsigned int u : chunk.partitions[partition]) {
+        const ObjVertexKey &key = chunk.uniques[u];
+        const unsigned int o =
+            static_cast<unsigned int>(chunk.uniqueOffset + u);
+        kept[o] = cache.insert(key.s, key.v, key.t, key.n, o, vertices[o]);
+      }
+    }
+  });
+  runParallel(n_chunks, [&](std::size_t i) {
+    ObjChunk &chunk = chunks[i];
+    for (std::size_t u = 0; u < chunk.uniques.size(); u++) {
+      if (kept[chunk.uniqueOffset + u]) {
+        chunk.nVertices++;
+        chunk.submeshVertices[chunk.uniques[u].s - chunk.firstSubmesh]++;
+      }
+    }
+  });
+
+  std::vector<ObjSubmesh> submeshes(materials.size());
+  std::size_t n_vertices = 0;
+  for (ObjChunk &chunk : chunks) {
+    chunk.vertexOffset = n_vertices;
+    n_vertices += chunk.nVertices;
+    for (std::size_t k = 0; k < chunk.submeshCorners.size(); k++) {
+      submeshes[chunk.firstSubmesh + k].nIndices += chunk.submeshCorners[k];
+      submeshes[chunk.firstSubmesh + k].nVertices += chunk.submeshVertices[k];
+    }
+  }
+  unsigned int base_index = 0, base_vertex = 0;
+  for (std::size_t s = 0; s < submeshes.size(); s++) {
+    submeshes[s].baseIndex = base_index;
+    submeshes[s].baseVertex = base_vertex;
+    submeshes[s].material = materials[s];
+    base_index += submeshes[s].nIndices;
+    base_vertex += submeshes[s].nVertices;
+  }
+
+  data.positions.resize(n_vertices);
+  data.normals.resize(has_normals ? n_vertices : 0);
+  data.texcoords.resize(has_texcoords ? n_vertices : 0);
+  data.indices.resize(n_indices);
+  runParallel(n_chunks, [&](std::size_t i) {
+    const ObjChunk &chunk = chunks[i];
+    unsigned int vertex = static_cast<unsigned int>(chunk.vertexOffset);
+    for (std::size_t u = 0; u < chunk.uniques.size(); u++) {
+      if (!kept[chunk.uniqueOffset + u]) {
+        continue;
+      }
+      const ObjVertexKey &key = chunk.uniques[u];
+      vertices[chunk.uniqueOffset + u] = vertex;
+      data.positions[vertex] = v[key.v];
+      if (has_texcoords) {
+        data.texcoords[vertex] = key.t >= 0 ? vt[key.t] : glm::vec2(0.0f);
+      }
+      if (has_normals) {
+        data.normals[vertex] = key.n >= 0 ? vn[key.n] : glm::vec3(0.0f);
+      }
+      vertex++;
+    }
+  });
+  // Vertices that were not kept still hold the key of the kept one.
+  runParallel(n_chunks, [&](std::size_t i) {
+    const ObjChunk &chunk = chunks[i];
+    for (std::size_t u = 0; u < chunk.uniques.size(); u++) {
+      const std::size_t o = chunk.uniqueOffset + u;
+      if (!kept[o]) {
+        vertices[o] = vertices[vertices[o]];
+      }
+    }
+    for (std::size_t c = 0; c < chunk.cornerUniques.size(); c++) {
+      const unsigned int u = chunk.cornerUniques[c];
+      data.indices[chunk.cornerOffset + c] =
+          vertices[chunk.uniqueOffset + u] -
+          submeshes[chunk.uniques[u].s].baseVertex;
+    }
+  });
+
+  for (const ObjSubmesh &submesh : submeshes) {
+    if (submesh.nIndices > 0) {
+      data.submeshes.push_back(submesh);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Wavefront OBJ/MTL Reader
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_OBJ_HPP
+#define MGL_OBJ_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+class ObjReader;
+struct ObjMaterial;
+struct ObjSubmesh;
+struct ObjData;
+
+////////////////////////////////////////////////////////////////////// ObjData
+
+struct ObjMaterial {
+  std::string name;
+  glm::vec3 ambient = glm::vec3(0.0f);
+  glm::vec3 diffuse = glm::vec3(0.6f);
+  glm::vec3 specular = glm::vec3(0.0f);
+  glm::vec3 emissive = glm::vec3(0.0f);
+  float shininess = 0.0f;
+  float opacity = 1.0f;
+  std::string diffuseMap;
+};
+
+// Indices are relative to baseVertex, as drawn by glDrawElementsBaseVertex.
+struct ObjSubmesh {
+  unsigned int baseIndex = 0;
+  unsigned int nIndices = 0;
+  unsigned int baseVertex = 0;
+  unsigned int nVertices = 0;
+  int material = -1;
+};
+
+// Normals and texcoords are empty if no face provided them; faces missing
+// them in a file that has them get zeros.
+struct ObjData {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> texcoords;
+  std::vector<unsigned int> indices;
+  std::vector<ObjSubmesh> submeshes;
+  std::vector<ObjMaterial> materials;
+};
+
+////////////////////////////////////////////////////////////////////// ObjReader
+//
+// Reads the subset of OBJ that modelling tools export (v, vt, vn, f, o, g,
+// usemtl, mtllib) from a memory-mapped file, straight into indexed vertex
+// arrays. Polygons are fan triangulated, and face corners sharing the same
+// v/vt/vn triple are emitted once per submesh. This is close to Assimp with
+// aiProcess_Triangulate | aiProcess_JoinIdenticalVertices, which joins
+// vertices by value instead: distinct v, vt or vn entries holding the same
+// values stay separate vertices here, until a weld merges them.
+// A new submesh starts at each object, group or material change.
+//
+// With more than one thread, files of at least two chunks are split at line
+// boundaries and the chunks are parsed, resolved and welded in parallel. The
+// result is identical to the single threaded one.
+
+class ObjReader {
+ public:
+  static const std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  ObjReader();
+  void flipUVs();
+  // 0 uses one thread per hardware thread.
+  void setThreads(unsigned int threads);
+  // Throws LoadError if the file cannot be opened or indexes past its data.
+  void read(const std::string &filename, ObjData &data);
+
+  static bool canRead(const std::string &filename);
+
+ private:
+  bool FlipUVs;
+  unsigned int Threads;
+
+  void readSequential(const char *p, const char *end,
+                      const std::string &filename, ObjData &data);
+  void readParallel(const char *p, const char *end, std::size_t chunks,
+                    const std::string &filename, ObjData &data);
+  void readMaterials(const std::string &filename, ObjData &data);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_OBJ_HPP */
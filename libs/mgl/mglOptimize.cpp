@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Index Buffer Optimization
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglOptimize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////// VERTEX CACHE ORDER
+
+static const int CACHE_SIZE = 32;
+static const unsigned int MAX_VALENCE = 32;
+static const std::size_t NO_TRIANGLE = ~std::size_t(0);
+
+// Scores by cache position and by triangles left, as tabulated by Forsyth.
+struct ScoreTables {
+  float Cache[CACHE_SIZE];
+  float Valence[MAX_VALENCE + 1];
+
+  ScoreTables() {
+    for (int i = 0; i < CACHE_SIZE; i++) {
+      // The last triangle's vertices score the same whatever their order.
+      Cache[i] = i < 3 ? 0.75f
+                       : std::pow(1.0f - float(i - 3) / (CACHE_SIZE - 3), 1.5f);
+    }
+    Valence[0] = 0.0f;
+    for (unsigned int i = 1; i <= MAX_VALENCE; i++) {
+      Valence[i] = 2.0f / std::sqrt(float(i));
+    }
+  }
+
+  float score(int position, unsigned int valence) const {
+    if (valence == 0) {
+      return -1.0f;
+    }
+    return (position >= 0 ? Cache[position] : 0.0f) +
+           Valence[std::min(valence, MAX_VALENCE)];
+  }
+};
+
+void optimizeVertexCache(unsigned int *indices, std::size_t count,
+                         std::size_t vertexCount) {
+  const std::size_t triangles = count / 3;
+  if (triangles == 0) {
+    return;
+  }
+  static const ScoreTables tables;
+
+  // Triangles of each vertex; the first Valence[v] are those not yet emitted.
+  std::vector<unsigned int> offsets(vertexCount + 1, 0);
+  for (std::size_t i = 0; i < triangles * 3; i++) {
+    offsets[indices[i] + 1]++;
+  }
+  for (std::size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+  std::vector<unsigned int> valence(vertexCount);
+  for (std::size_t v = 0; v < vertexCount; v++) {
+    valence[v] = offsets[v + 1] - offsets[v];
+  }
+  std::vector<unsigned int> adjacency(triangles * 3);
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (std::size_t i = 0; i < triangles * 3; i++) {
+    adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+  }
+  std::vector<int> positions(vertexCount, -1);
+  std::vector<float> scores(vertexCount);
+  for (std::size_t v = 0; v < vertexCount; v++) {
+    scores[v] = tables.score(-1, valence[v]);
+  }
+  std::vector<float> triangle_scores(triangles);
+  std::vector<unsigned char> emitted(triangles, 0);
+  std::size_t best = 0;
+  for (std::size_t t = 0; t < triangles; t++) {
+    const unsigned int *tri = &indices[t * 3];
+    triangle_scores[t] = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+    if (triangle_scores[t] > triangle_scores[best]) {
+      best = t;
+    }
+  }
+
+  std::vector<unsigned int> output(triangles * 3);
+  unsigned int cache[CACHE_SIZE + 3];
+  int cached = 0;
+  std::size_t cursor = 0;
+  for (std::size_t out = 0; out < triangles; out++) {
+    // With no candidate in the cache, restart from the next triangle left.
+    if (best == NO_TRIANGLE) {
+      while (emitted[cursor]) {
+        cursor++;
+      }
+      best = cursor;
+    }
+    const unsigned int *tri = &indices[best * 3];
+    emitted[best] = 1;
+    std::copy(tri, tri + 3, &output[out * 3]);
+    for (int k = 0; k < 3; k++) {
+      const unsigned int v = tri[k];
+      unsigned int *first = &adjacency[offsets[v]];
+      unsigned int *last = first + valence[v] - 1;
+      *std::find(first, last, static_cast<unsigned int>(best)) = *last;
+      valence[v]--;
+    }
+
+    // The triangle's vertices go to the front; the rest shift back.
+    unsigned int next[CACHE_SIZE + 3];
+    int n = 0;
+    for (int k = 0; k < 3; k++) {
+      if (std::find(next, next + n, tri[k]) == next + n) {
+        next[n++] = tri[k];
+      }
+    }
+    for (int i = 0; i < cached; i++) {
+      if (std::find(tri, tri + 3, cache[i]) == tri + 3) {
+        next[n++] = cache[i];
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      const unsigned int v = next[i];
+      positions[v] = i < CACHE_SIZE ? i : -1;
+      scores[v] = tables.score(positions[v], valence[v]);
+    }
+
+    // Only triangles around vertices whose score changed are rescored.
+    best = NO_TRIANGLE;
+    float best_score = -1.0f;
+    for (int i = 0; i < n; i++) {
+      const unsigned int v = next[i];
+      for (unsigned int a = offsets[v]; a < offsets[v] + valence[v]; a++) {
+        const unsigned int t = adjacency[a];
+        const unsigned int *other = &indices[t * 3];
+        triangle_scores[t] =
+            scores[other[0]] + scores[other[1]] + scores[other[2]];
+        if (triangle_scores[t] > best_score) {
+          best_score = triangle_scores[t];
+          best = t;
+        }
+      }
+    }
+    cached = std::min(n, CACHE_SIZE);
+    std::copy(next, next + cached, cache);
+  }
+  std::copy(output.begin(), output.end(), indices);
+}
+
+float computeCacheMissRatio(const unsigned int *indices, std::size_t count,
+                            std::size_t vertexCount, unsigned int cacheSize) {
+  const std::size_t triangles = count / 3;
+  if (triangles == 0) {
+    return 0.0f;
+  }
+  // A vertex is cached if fewer than cacheSize misses followed its own.
+  std::vector<std::size_t> loaded(vertexCount, 0);
+  std::size_t misses = 0;
+  for (std::size_t i = 0; i < triangles * 3; i++) {
+    const unsigned int v = indices[i];
+    if (loaded[v] == 0 || misses - loaded[v] >= cacheSize) {
+      loaded[v] = ++misses;
+    }
+  }
+  return static_cast<float>(misses) / static_cast<float>(triangles);
+}
+
+////////////////////////////////////////////////////////////// VERTEX CLUSTERING
+
+// Cells are packed 21 bits per axis, which covers any grid a level of detail
+// is built with.
+static uint64_t cellKey(const glm::vec3 &position, float scale) {
+  const glm::vec3 cell = glm::floor(position * scale);
+  const uint64_t mask = (1u << 21) - 1;
+  return (static_cast<uint64_t>(static_cast<int64_t>(cell.x)) & mask) |
+         (static_cast<uint64_t>(static_cast<int64_t>(cell.y)) & mask) << 21 |
+         (static_cast<uint64_t>(static_cast<int64_t>(cell.z)) & mask) << 42;
+}
+
+struct TriangleHash {
+  std::size_t operator()(const std::pair<uint64_t, unsigned int> &t) const {
+    return std::hash<uint64_t>()(t.first * 0x9E3779B97F4A7C15ull ^ t.second);
+  }
+};
+
+std::vector<unsigned int> simplifyClusters(const glm::vec3 *positions,
+                                           const unsigned int *indices,
+                                           std::size_t count, float cellSize) {
+  const float scale = cellSize > 0.0f ? 1.0f / cellSize : 0.0f;
+  const std::size_t vertices =
+      count > 0 ? *std::max_element(indices, indices + count) + std::size_t(1)
+                : 0;
+  std::unordered_map<uint64_t, unsigned int> cells;
+  std::vector<unsigned int> collapsed(vertices, ~0u);
+  auto cluster = [&](unsigned int v) {
+    if (collapsed[v] == ~0u) {
+      collapsed[v] =
+          cells.emplace(cellKey(positions[v], scale), v).first->second;
+    }
+    return collapsed[v];
+  };
+
+  // Triangles are compared starting from their smallest index, which keeps
+  // the winding.
+  std::unordered_set<std::pair<uint64_t, unsigned int>, TriangleHash> seen;
+  std::vector<unsigned int> result;
+  for (std::size_t i = 0; i + 2 < count; i += 3) {
+    unsigned int tri[3] = {cluster(indices[i]), cluster(indices[i + 1]),
+                           cluster(indices[i + 2])};
+    if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+      continue;
+    }
+    std::rotate(tri, std::min_element(tri, tri + 3), tri + 3);
+    if (!seen.emplace(uint64_t(tri[0]) << 32 | tri[1], tri[2]).second) {
+      continue;
+    }
+    result.insert(result.end(), tri, tri + 3);
+  }
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Index Buffer Optimization
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_OPTIMIZE_HPP
+#define MGL_OPTIMIZE_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////// VERTEX CACHE ORDER
+//
+// Reorders the triangles of an index list so that vertices are reused while
+// still in the post-transform cache, with Tom Forsyth's greedy algorithm:
+// each step emits the triangle whose vertices score best, favouring vertices
+// recently used and vertices with few triangles left. Vertices are not moved.
+
+void optimizeVertexCache(unsigned int *indices, std::size_t count,
+                         std::size_t vertexCount);
+
+// Average cache miss ratio: vertices transformed per triangle with a FIFO
+// cache of the given size. 3 is the worst case, around 0.6 to 0.7 is typical
+// of an optimized mesh.
+float computeCacheMissRatio(const unsigned int *indices, std::size_t count,
+                            std::size_t vertexCount,
+                            unsigned int cacheSize = 32);
+
+////////////////////////////////////////////////////////////// VERTEX CLUSTERING
+//
+// A coarser index list for a level of detail: vertices are snapped to a grid
+// of cellSize, each cell collapses to the first vertex found in it, and
+// triangles left degenerate or duplicated are dropped. The result references
+// the original vertices, so every level shares the vertex buffer.
+
+std::vector<unsigned int> simplifyClusters(const glm::vec3 *positions,
+                                           const unsigned int *indices,
+                                           std::size_t count, float cellSize);
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_OPTIMIZE_HPP */
@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asset Packs
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglPack.hpp"
+
+#include <assimp/MemoryIOWrapper.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////// PACK FORMAT
+
+static_assert(sizeof(PackHeader) == 16, "PackHeader is stored as is");
+static_assert(sizeof(PackEntry) == 24, "PackEntry is stored as is");
+
+// Backslashes become slashes and a leading "./" is dropped.
+static std::string normalizeName(const std::string &filename) {
+  std::string name = filename;
+  std::replace(name.begin(), name.end(), '\\', '/');
+  while (name.compare(0, 2, "./") == 0) {
+    name.erase(0, 2);
+  }
+  return name;
+}
+
+static uint64_t alignOffset(uint64_t offset) {
+  return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+////////////////////////////////////////////////////////////////////// AssetPack
+
+bool AssetPack::open(const std::string &filename) {
+  if (!File.open(filename)) {
+    return false;
+  }
+  const char *data = File.data();
+  const uint64_t size = File.size();
+  PackHeader header;
+  if (size < sizeof(header)) {
+    std::cerr << "[ERROR] " << filename << " is not a pack" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+      header.Version != PACK_VERSION) {
+    std::cerr << "[ERROR] " << filename << " is not a pack of version "
+              << PACK_VERSION << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // The table of contents is only checked, which pages it in.
+  Entries = reinterpret_cast<const PackEntry *>(data + sizeof(header));
+  EntryCount = header.EntryCount;
+  bool valid = sizeof(header) + EntryCount * sizeof(PackEntry) <= size;
+  for (std::size_t i = 0; valid && i < EntryCount; i++) {
+    const PackEntry &entry = Entries[i];
+    valid = entry.NameOffset + uint64_t(entry.NameSize) <= size &&
+            entry.Offset <= size && entry.Size <= size - entry.Offset &&
+            (i == 0 || getName(i - 1) < getName(i));
+  }
+  if (!valid) {
+    std::cerr << "[ERROR] " << filename << " is corrupted" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return true;
+}
+
+bool AssetPack::find(std::string_view name, std::string_view &contents) const {
+  std::size_t first = 0, last = EntryCount;
+  while (first < last) {
+    const std::size_t middle = first + (last - first) / 2;
+    const int order = getName(middle).compare(name);
+    if (order == 0) {
+      contents = getContents(middle);
+      return true;
+    }
+    if (order < 0) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return false;
+}
+
+std::size_t AssetPack::getEntryCount() const { return EntryCount; }
+
+std::string_view AssetPack::getName(std::size_t i) const {
+  return std::string_view(File.data() + Entries[i].NameOffset,
+                          Entries[i].NameSize);
+}
+
+std::string_view AssetPack::getContents(std::size_t i) const {
+  return std::string_view(File.data() + Entries[i].Offset,
+                          static_cast<std::size_t>(Entries[i].Size));
+}
+
+///////////////////////////////////////////////////////////////////// AssetPacks
+
+AssetPacks &AssetPacks::getInstance() {
+  static AssetPacks instance;
+  return instance;
+}
+
+bool AssetPacks::mount(const std::string &filename,
+                       const std::string &prefix) {
+  std::unique_ptr<AssetPack> pack(new AssetPack());
+  if (!pack->open(filename)) {
+    return false;
+  }
+  Mounts.push_back({normalizeName(prefix), std::move(pack)});
+  return true;
+}
+
+void AssetPacks::unmountAll() { Mounts.clear(); }
+
+bool AssetPacks::empty() const { return Mounts.empty(); }
+
+bool AssetPacks::find(const std::string &filename,
+                      std::string_view &contents) const {
+  if (Mounts.empty()) {
+    return false;
+  }
+  const std::string name = normalizeName(filename);
+  for (auto mount = Mounts.rbegin(); mount != Mounts.rend(); ++mount) {
+    if (name.compare(0, mount->Prefix.size(), mount->Prefix) == 0 &&
+        mount->Pack->find(
+            std::string_view(name).substr(mount->Prefix.size()), contents)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////// AssetFile
+
+bool AssetFile::open(const std::string &filename) {
+  File.close();
+  if (AssetPacks::getInstance().find(filename, View)) {
+    return true;
+  }
+  if (!File.open(filename)) {
+    View = std::string_view();
+    return false;
+  }
+  View = std::string_view(File.data(), File.size());
+  return true;
+}
+
+const char *AssetFile::data() const { return View.data(); }
+
+std::size_t AssetFile::size() const { return View.size(); }
+
+std::string_view AssetFile::view() const { return View; }
+
+///////////////////////////////////////////////////////////////////// PackWriter
+
+void PackWriter::add(const std::string &name, const std::string &filename) {
+  Sources.push_back({normalizeName(name), filename});
+}
+
+// Files are mapped twice, first for their sizes and then for their contents,
+// so that only one of them is in memory at a time.
+std::size_t PackWriter::write(const std::string &filename) {
+  std::sort(Sources.begin(), Sources.end(),
+            [](const Source &a, const Source &b) { return a.Name < b.Name; });
+  for (std::size_t i = 1; i < Sources.size(); i++) {
+    if (Sources[i].Name == Sources[i - 1].Name) {
+      std::cerr << "[ERROR] " << Sources[i].Name << " is packed twice"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  PackHeader header = {};
+  std::memcpy(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+  header.Version = PACK_VERSION;
+  header.EntryCount = static_cast<uint32_t>(Sources.size());
+  std::vector<PackEntry> entries(Sources.size());
+  uint64_t offset = sizeof(header) + entries.size() * sizeof(PackEntry);
+  for (std::size_t i = 0; i < Sources.size(); i++) {
+    entries[i].NameOffset = static_cast<uint32_t>(offset);
+    entries[i].NameSize = static_cast<uint32_t>(Sources[i].Name.size());
+    offset += Sources[i].Name.size();
+  }
+  MappedFile source;
+  for (std::size_t i = 0; i < Sources.size(); i++) {
+    if (!source.open(Sources[i].Filename)) {
+      std::cerr << "[ERROR] Cannot read " << Sources[i].Filename << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    offset = alignOffset(offset);
+    entries[i].Offset = offset;
+    entries[i].Size = source.size();
+    offset += source.size();
+  }
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) {
+    std::cerr << "[ERROR] Cannot write " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            entries.size() * sizeof(PackEntry));
+  for (const Source &s : Sources) {
+    out.write(s.Name.data(), s.Name.size());
+  }
+  const char padding[PACK_ALIGNMENT] = {};
+  for (std::size_t i = 0; i < Sources.size(); i++) {
+    const uint64_t position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, entries[i].Offset - position);
+    if (!source.open(Sources[i].Filename) ||
+        source.size() != entries[i].Size) {
+      std::cerr << "[ERROR] " << Sources[i].Filename
+                << " changed while being packed" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    out.write(source.data(), source.size());
+  }
+  out.close();
+  if (out.fail()) {
+    std::cerr << "[ERROR] Failed to write " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return static_cast<std::size_t>(offset);
+}
+
+/////////////////////////////////////////////////////////////////// PackIOSystem
+
+bool PackIOSystem::Exists(const char *file) const {
+  std::string_view contents;
+  return AssetPacks::getInstance().find(file, contents) || Disk.Exists(file);
+}
+
+char PackIOSystem::getOsSeparator() const { return '/'; }
+
+Assimp::IOStream *PackIOSystem::Open(const char *file, const char *mode) {
+  std::string_view contents;
+  if (std::strchr(mode, 'w') == nullptr &&
+      AssetPacks::getInstance().find(file, contents)) {
+    return new Assimp::MemoryIOStream(
+        reinterpret_cast<const uint8_t *>(contents.data()), contents.size());
+  }
+  return Disk.Open(file, mode);
+}
+
+void PackIOSystem::Close(Assimp::IOStream *stream) { delete stream; }
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
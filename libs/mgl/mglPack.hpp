@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asset Packs
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_PACK_HPP
+#define MGL_PACK_HPP
+
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOSystem.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./mglFile.hpp"
+
+namespace mgl {
+
+class AssetPack;
+class AssetPacks;
+class AssetFile;
+class PackWriter;
+class PackIOSystem;
+
+//////////////////////////////////////////////////////////////////// PACK FORMAT
+//
+// A pack is many asset files in one, so that loading them costs a single
+// open and mapping. A PackHeader is followed by its table of contents, one
+// PackEntry per file sorted by name, then the names and the file contents.
+// Contents start on PACK_ALIGNMENT boundaries. Names use '/' separators.
+// Nothing is read or built when a pack is mounted: lookups binary search the
+// mapped table of contents, and files are views into the mapping.
+
+const char PACK_MAGIC[4] = {'M', 'G', 'L', 'P'};
+const uint32_t PACK_VERSION = 1;
+const uint64_t PACK_ALIGNMENT = 64;
+const char PACK_EXTENSION[] = ".mglp";
+
+struct PackHeader {
+  char Magic[4];
+  uint32_t Version;
+  uint32_t EntryCount;
+  uint32_t Reserved;
+};
+
+struct PackEntry {
+  uint64_t Offset;
+  uint64_t Size;
+  uint32_t NameOffset;
+  uint32_t NameSize;
+};
+
+////////////////////////////////////////////////////////////////////// AssetPack
+
+class AssetPack {
+ public:
+  AssetPack() = default;
+  AssetPack(const AssetPack &) = delete;
+  AssetPack &operator=(const AssetPack &) = delete;
+
+  // False if the file cannot be opened; exits if it is not a valid pack.
+  bool open(const std::string &filename);
+  bool find(std::string_view name, std::string_view &contents) const;
+  std::size_t getEntryCount() const;
+  std::string_view getName(std::size_t i) const;
+  std::string_view getContents(std::size_t i) const;
+
+ private:
+  MappedFile File;
+  const PackEntry *Entries = nullptr;
+  std::size_t EntryCount = 0;
+};
+
+///////////////////////////////////////////////////////////////////// AssetPacks
+//
+// The packs files are looked up in, before the file system. Packs are mounted
+// under a prefix, such as "assets/", stripped from names before they are
+// looked up, and the last mounted pack is searched first. Mounting is not
+// thread safe and must be done before loading starts; lookups may then be
+// made from any thread.
+
+class AssetPacks {
+ public:
+  static AssetPacks &getInstance();
+
+  bool mount(const std::string &filename, const std::string &prefix = "");
+  void unmountAll();
+  bool empty() const;
+  bool find(const std::string &filename, std::string_view &contents) const;
+
+ private:
+  struct Mount {
+    std::string Prefix;
+    std::unique_ptr<AssetPack> Pack;
+  };
+  std::vector<Mount> Mounts;
+
+  AssetPacks() = default;
+
+ public:
+  AssetPacks(AssetPacks const &) = delete;
+  void operator=(AssetPacks const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////// AssetFile
+//
+// Read-only view of an asset: of its entry in a mounted pack if there is one,
+// or else of the mapped file.
+
+class AssetFile {
+ public:
+  AssetFile() = default;
+  AssetFile(const AssetFile &) = delete;
+  AssetFile &operator=(const AssetFile &) = delete;
+
+  bool open(const std::string &filename);
+  const char *data() const;
+  std::size_t size() const;
+  std::string_view view() const;
+
+ private:
+  MappedFile File;
+  std::string_view View;
+};
+
+///////////////////////////////////////////////////////////////////// PackWriter
+
+class PackWriter {
+ public:
+  // The contents of filename are stored under name.
+  void add(const std::string &name, const std::string &filename);
+  // Exits if a file cannot be read or the pack cannot be written.
+  std::size_t write(const std::string &filename);
+
+ private:
+  struct Source {
+    std::string Name;
+    std::string Filename;
+  };
+  std::vector<Source> Sources;
+};
+
+/////////////////////////////////////////////////////////////////// PackIOSystem
+//
+// Serves Assimp the files of the mounted packs, including those a model
+// references such as material libraries, and falls back to the file system.
+// An importer takes ownership of it with Assimp::Importer::SetIOHandler().
+
+class PackIOSystem : public Assimp::IOSystem {
+ public:
+  bool Exists(const char *file) const override;
+  char getOsSeparator() const override;
+  Assimp::IOStream *Open(const char *file, const char *mode = "rb") override;
+  void Close(Assimp::IOStream *stream) override;
+
+ private:
+  Assimp::DefaultIOSystem Disk;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_PACK_HPP */
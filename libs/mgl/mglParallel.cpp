@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Parallel Loops
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglParallel.hpp"
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////////// JobPool
+
+JobPool &JobPool::getInstance() {
+  static JobPool instance;
+  return instance;
+}
+
+// One worker per hardware thread besides the calling one.
+JobPool::JobPool() {
+  BatchTask = nullptr;
+  BatchBody = nullptr;
+  BatchCount = 0;
+  Generation = 0;
+  Active = 0;
+  Stopping = false;
+  Next = 0;
+  Done = 0;
+  for (unsigned int i = 1; i < resolveThreads(0); i++) {
+    Workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+JobPool::~JobPool() {
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stopping = true;
+  }
+  WorkReady.notify_all();
+  for (std::thread &worker : Workers) {
+    worker.join();
+  }
+}
+
+unsigned int JobPool::getThreadCount() const {
+  return static_cast<unsigned int>(Workers.size() + 1);
+}
+
+// A batch only starts once no worker is left in the previous one, so a late
+// worker cannot take a job of the new batch with the task of the old one.
+void JobPool::dispatch(std::size_t count, Task task, const void *body) {
+  if (count <= 1 || Workers.empty()) {
+    for (std::size_t i = 0; i < count; i++) {
+      task(body, i);
+    }
+    return;
+  }
+  std::lock_guard<std::mutex> batch(BatchMutex);
+  std::unique_lock<std::mutex> lock(Mutex);
+  Finished.wait(lock, [this]() { return Active == 0; });
+  BatchTask = task;
+  BatchBody = body;
+  BatchCount = count;
+  Next = 0;
+  Done = 0;
+  Generation++;
+  lock.unlock();
+  WorkReady.notify_all();
+  work(task, body, count);
+  lock.lock();
+  Finished.wait(lock, [this, count]() { return Done == count; });
+}
+
+void JobPool::work(Task task, const void *body, std::size_t count) {
+  for (std::size_t i = Next++; i < count; i = Next++) {
+    task(body, i);
+    if (++Done == count) {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Finished.notify_all();
+    }
+  }
+}
+
+void JobPool::workerLoop() {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(Mutex);
+  for (;;) {
+    WorkReady.wait(lock, [&]() { return Stopping || Generation != seen; });
+    if (Stopping) {
+      return;
+    }
+    seen = Generation;
+    const Task task = BatchTask;
+    const void *body = BatchBody;
+    const std::size_t count = BatchCount;
+    Active++;
+    lock.unlock();
+    work(task, body, count);
+    lock.lock();
+    if (--Active == 0) {
+      Finished.notify_all();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
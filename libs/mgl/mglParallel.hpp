@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Parallel Loops
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_PARALLEL_HPP
+#define MGL_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mgl {
+
+class JobPool;
+
+// Fork-join helpers for the CPU stages of asset loading. Threads are started
+// per call, which is cheap next to the work of a load step, and the calling
+// thread takes the first share. Work repeated every frame uses JobPool.
+
+// 0 means one thread per hardware thread.
+inline unsigned int resolveThreads(unsigned int threads) {
+  return threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Runs body(0) to body(count - 1), each on its own thread. Once all are
+// done, the exception of the first body that threw is rethrown.
+template <typename Body> void runParallel(std::size_t count, const Body &body) {
+  std::vector<std::exception_ptr> errors(count);
+  auto run = [&body, &errors](std::size_t i) {
+    try {
+      body(i);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < count; i++) {
+    threads.emplace_back(run, i);
+  }
+  run(0);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (const std::exception_ptr &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+// Splits [0, n) into count contiguous ranges: range i is
+// [rangeBegin(n, count, i), rangeBegin(n, count, i + 1)).
+inline std::size_t rangeBegin(std::size_t n, std::size_t count,
+                              std::size_t i) {
+  return n / count * i + std::min(i, n % count);
+}
+
+//////////////////////////////////////////////////////////////////////// JobPool
+//
+// Threads kept for per-frame work, such as posing characters, where starting
+// and joining threads at every call would cost as much as the work itself.
+// run() is a fork-join like runParallel(): it runs body(0) to
+// body(count - 1), with the calling thread working alongside the pool, and
+// returns once all are done. Jobs are handed out one at a time, so count may
+// exceed the number of threads. Calls from several threads are serialized,
+// and a body must not call run() itself.
+
+class JobPool {
+ public:
+  static JobPool &getInstance();
+
+  // Threads that take jobs, counting the calling thread.
+  unsigned int getThreadCount() const;
+
+  template <typename Body> void run(std::size_t count, const Body &body) {
+    dispatch(count, &invoke<Body>, &body);
+  }
+
+ private:
+  typedef void (*Task)(const void *body, std::size_t i);
+
+  std::vector<std::thread> Workers;
+  std::mutex BatchMutex;
+  std::mutex Mutex;
+  std::condition_variable WorkReady;
+  std::condition_variable Finished;
+  Task BatchTask;
+  const void *BatchBody;
+  std::size_t BatchCount;
+  uint64_t Generation;
+  unsigned int Active;
+  bool Stopping;
+  std::atomic<std::size_t> Next;
+  std::atomic<std::size_t> Done;
+
+  JobPool();
+  ~JobPool();
+  template <typename Body>
+  static void invoke(const void *body, std::size_t i) {
+    (*static_cast<const Body *>(body))(i);
+  }
+  void dispatch(std::size_t count, Task task, const void *body);
+  void work(Task task, const void *body, std::size_t count);
+  void workerLoop();
+
+ public:
+  JobPool(JobPool const &) = delete;
+  void operator=(JobPool const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_PARALLEL_HPP */
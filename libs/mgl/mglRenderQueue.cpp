@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Render Queue Class
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglRenderQueue.hpp"
+
+#include <cstring>
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////// RenderQueue
+
+const unsigned int RenderQueue::PROGRAM_BITS;
+const unsigned int RenderQueue::FORMAT_BITS;
+const unsigned int RenderQueue::MESH_BITS;
+const unsigned int RenderQueue::DEPTH_BITS;
+
+static const unsigned int DEPTH_SHIFT = 0;
+static const unsigned int MESH_SHIFT = RenderQueue::DEPTH_BITS;
+static const unsigned int FORMAT_SHIFT = MESH_SHIFT + RenderQueue::MESH_BITS;
+static const unsigned int PROGRAM_SHIFT =
+    FORMAT_SHIFT + RenderQueue::FORMAT_BITS;
+
+static uint64_t field(unsigned int value, unsigned int bits,
+                      unsigned int shift) {
+  return (static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1)) << shift;
+}
+
+uint64_t RenderQueue::makeKey(unsigned int program, unsigned int format,
+                              unsigned int mesh, float depth) {
+  // The bit pattern of a non-negative float grows with its value, so its
+  // upper bits are a monotonic, logarithmically spaced depth bucket.
+  uint32_t depth_bits = 0;
+  if (depth > 0.0f) {
+    std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+  }
+  return field(program, PROGRAM_BITS, PROGRAM_SHIFT) |
+         field(format, FORMAT_BITS, FORMAT_SHIFT) |
+         field(mesh, MESH_BITS, MESH_SHIFT) |
+         field(depth_bits >> (32 - DEPTH_BITS), DEPTH_BITS, DEPTH_SHIFT);
+}
+
+unsigned int RenderQueue::getProgram(uint64_t key) {
+  return static_cast<unsigned int>(key >> PROGRAM_SHIFT) &
+         ((1u << PROGRAM_BITS) - 1);
+}
+
+unsigned int RenderQueue::getFormat(uint64_t key) {
+  return static_cast<unsigned int>(key >> FORMAT_SHIFT) &
+         ((1u << FORMAT_BITS) - 1);
+}
+
+unsigned int RenderQueue::getMesh(uint64_t key) {
+  return static_cast<unsigned int>(key >> MESH_SHIFT) &
+         ((1u << MESH_BITS) - 1);
+}
+
+void RenderQueue::clear() { Entries.clear(); }
+
+void RenderQueue::push(uint64_t key, unsigned int item) {
+  Entries.push_back({key, item});
+}
+
+std::size_t RenderQueue::size() const { return Entries.size(); }
+
+const RenderQueue::Entry &RenderQueue::operator[](std::size_t i) const {
+  return Entries[i];
+}
+
+void RenderQueue::sort() {
+  // LSD radix sort, one byte per pass. All eight histograms are built in a
+  // single read of the keys, and passes where every key shares the same byte
+  // (typically the unused high program bits) are skipped.
+  const std::size_t n = Entries.size();
+  if (n < 2) {
+    return;
+  }
+  std::size_t counts[8][256];
+  std::memset(counts, 0, sizeof(counts));
+  for (const Entry &entry : Entries) {
+    for (int pass = 0; pass < 8; pass++) {
+      counts[pass][(entry.key >> (pass * 8)) & 0xff]++;
+    }
+  }
+
+  Scratch.resize(n);
+  for (int pass = 0; pass < 8; pass++) {
+    std::size_t *count = counts[pass];
+    const unsigned int first = (Entries[0].key >> (pass * 8)) & 0xff;
+    if (count[first] == n) {
+      continue;
+    }
+    std::size_t offset = 0;
+    for (int b = 0; b < 256; b++) {
+      const std::size_t c = count[b];
+      count[b] = offset;
+      offset += c;
+    }
+    for (const Entry &entry : Entries) {
+      Scratch[count[(entry.key >> (pass * 8)) & 0xff]++] = entry;
+    }
+    Entries.swap(Scratch);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Render Queue Class
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_RENDER_QUEUE_HPP
+#define MGL_RENDER_QUEUE_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace mgl {
+
+class RenderQueue;
+
+//////////////////////////////////////////////////////////////////// RenderQueue
+//
+// Draws are recorded as a 64-bit sort key and an opaque item index, then
+// radix sorted so that draws sharing a program, then a vertex format, then a
+// mesh are contiguous and can be submitted without redundant binds. Within a
+// mesh, draws are ordered front to back by a depth bucket.
+//
+// Key layout (most significant first):
+//   [63..52] program   [51..44] vertex format   [43..16] mesh   [15..0] depth
+
+class RenderQueue {
+ public:
+  static const unsigned int PROGRAM_BITS = 12;
+  static const unsigned int FORMAT_BITS = 8;
+  static const unsigned int MESH_BITS = 28;
+  static const unsigned int DEPTH_BITS = 16;
+
+  struct Entry {
+    uint64_t key;
+    unsigned int item;
+  };
+
+  static uint64_t makeKey(unsigned int program, unsigned int format,
+                          unsigned int mesh, float depth);
+  static unsigned int getProgram(uint64_t key);
+  static unsigned int getFormat(uint64_t key);
+  static unsigned int getMesh(uint64_t key);
+
+  void clear();
+  void push(uint64_t key, unsigned int item);
+  void sort();
+  std::size_t size() const;
+  const Entry &operator[](std::size_t i) const;
+
+ private:
+  std::vector<Entry> Entries;
+  std::vector<Entry> Scratch;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_RENDER_QUEUE_HPP */
@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Resource Manager
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglResources.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include "./mglLoader.hpp"
+#include "./mglMesh.hpp"
+#include "./mglShader.hpp"
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////// ResourceManager
+
+// The loader is created first so that it is destroyed last: meshes still
+// loading when the program exits cancel their work in it.
+ResourceManager::ResourceManager() {
+  MeshLoader::getInstance();
+  GpuBudget = 0;
+  GpuBytes = 0;
+  Clock = 0;
+}
+
+ResourceManager &ResourceManager::getInstance() {
+  static ResourceManager instance;
+  return instance;
+}
+
+// A budget of 0 means unlimited.
+void ResourceManager::setGpuBudget(std::size_t bytes) { GpuBudget = bytes; }
+
+std::size_t ResourceManager::getGpuBudget() const { return GpuBudget; }
+
+// The mesh is loaded asynchronously; it is drawn once it is ready.
+ResourceManager::MeshHandle ResourceManager::acquireMesh(
+    const std::string &filename, unsigned int flags) {
+  Entry<Mesh> &entry = Meshes[MeshKey(filename, flags)];
+  if (!entry.resource) {
+    entry.resource = std::make_shared<Mesh>();
+    entry.resource->setAssimpFlags(flags);
+    entry.resource->createAsync(filename);
+    entry.loading = true;
+    Loading.push_back(MeshKey(filename, flags));
+  }
+  entry.lastUse = ++Clock;
+  return entry.resource;
+}
+
+// The builder adds shaders, attributes and uniforms and calls create(). It
+// only runs the first time the name is acquired.
+ResourceManager::ProgramHandle ResourceManager::acquireProgram(
+    const std::string &name, const ProgramBuilder &build) {
+  return acquireProgram(name, ShaderDefines(), build);
+}
+
+// Variants are keyed by the name followed by the sorted defines, as in
+// "tangram[COLOR_UV,LIGHTS=4]". The builder is called with the defines set.
+ResourceManager::ProgramHandle ResourceManager::acquireProgram(
+    const std::string &name, const ShaderDefines &defines,
+    const ProgramBuilder &build) {
+  std::string key = name;
+  for (const auto &define : defines) {
+    key += key.size() == name.size() ? "[" : ",";
+    key += define.second.empty() ? define.first
+                                 : define.first + "=" + define.second;
+  }
+  key += defines.empty() ? "" : "]";
+  Entry<ShaderProgram> &entry = Programs[key];
+  if (!entry.resource) {
+    entry.resource = std::make_shared<ShaderProgram>();
+    entry.resource->setDefines(defines);
+    build(*entry.resource);
+    entry.gpuBytes = entry.resource->getGpuBytes();
+    GpuBytes += entry.gpuBytes;
+  }
+  entry.lastUse = ++Clock;
+  return entry.resource;
+}
+
+// Meshes count once they are on the GPU; the engine calls collect() right
+// after uploading. Keys of meshes evicted while loading are dropped.
+void ResourceManager::accountUploads() {
+  std::size_t kept = 0;
+  for (const MeshKey &key : Loading) {
+    auto it = Meshes.find(key);
+    if (it == Meshes.end() || !it->second.loading) {
+      continue;
+    }
+    if (it->second.resource->isReady()) {
+      it->second.gpuBytes = it->second.resource->getGpuBytes();
+      it->second.loading = false;
+      GpuBytes += it->second.gpuBytes;
+    } else {
+      Loading[kept++] = key;
+    }
+  }
+  Loading.resize(kept);
+}
+
+template <typename Map>
+void ResourceManager::evict(Map &map, typename Map::iterator it) {
+  GpuBytes -= it->second.gpuBytes;
+  map.erase(it);
+}
+
+// Only the manager holds an unreferenced resource. Those are evicted least
+// recently acquired first, meshes and programs alike, from a single sorted
+// list rather than a search per eviction.
+void ResourceManager::collect() {
+  accountUploads();
+  if (GpuBudget == 0 || GpuBytes <= GpuBudget) {
+    return;
+  }
+  struct Candidate {
+    unsigned long long lastUse;
+    MeshMap::iterator mesh;
+    ProgramMap::iterator program;
+  };
+  std::vector<Candidate> candidates;
+  for (auto it = Meshes.begin(); it != Meshes.end(); ++it) {
+    if (it->second.resource.use_count() == 1) {
+      candidates.push_back({it->second.lastUse, it, Programs.end()});
+    }
+  }
+  for (auto it = Programs.begin(); it != Programs.end(); ++it) {
+    if (it->second.resource.use_count() == 1) {
+      candidates.push_back({it->second.lastUse, Meshes.end(), it});
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.lastUse < b.lastUse;
+            });
+  for (const Candidate &candidate : candidates) {
+    if (GpuBytes <= GpuBudget) {
+      break;
+    }
+    if (candidate.program != Programs.end()) {
+      evict(Programs, candidate.program);
+    } else {
+      evict(Meshes, candidate.mesh);
+    }
+  }
+}
+
+void ResourceManager::evictUnreferenced() {
+  for (auto it = Meshes.begin(); it != Meshes.end();) {
+    auto next = std::next(it);
+    if (it->second.resource.use_count() == 1) {
+      evict(Meshes, it);
+    }
+    it = next;
+  }
+  for (auto it = Programs.begin(); it != Programs.end();) {
+    auto next = std::next(it);
+    if (it->second.resource.use_count() == 1) {
+      evict(Programs, it);
+    }
+    it = next;
+  }
+}
+
+std::size_t ResourceManager::getGpuBytes() const { return GpuBytes; }
+
+ResourceManager::Usage ResourceManager::getUsage() const {
+  Usage usage;
+  for (const auto &it : Meshes) {
+    const Mesh &mesh = *it.second.resource;
+    usage.CpuBytes += mesh.getCpuBytes();
+    usage.GpuBytes += mesh.getGpuBytes();
+    usage.Resources++;
+    usage.Referenced += it.second.resource.use_count() > 1 ? 1 : 0;
+  }
+  for (const auto &it : Programs) {
+    usage.GpuBytes += it.second.resource->getGpuBytes();
+    usage.Resources++;
+    usage.Referenced += it.second.resource.use_count() > 1 ? 1 : 0;
+  }
+  return usage;
+}
+
+void ResourceManager::printReport(std::ostream &out) const {
+  for (const auto &it : Meshes) {
+    out << "[" << it.first.first << "] refs "
+        << it.second.resource.use_count() - 1 << ", ";
+    it.second.resource->printMemoryReport(out);
+  }
+  for (const auto &it : Programs) {
+    out << "[" << it.first << "] refs " << it.second.resource.use_count() - 1
+        << ", GPU " << it.second.resource->getGpuBytes() << " bytes"
+        << std::endl;
+  }
+  const Usage usage = getUsage();
+  out << "Total CPU " << usage.CpuBytes << " bytes, GPU " << usage.GpuBytes
+      << " bytes (budget " << GpuBudget << ")" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
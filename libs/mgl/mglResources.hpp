@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Resource Manager
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_RESOURCES_HPP
+#define MGL_RESOURCES_HPP
+
+#include <assimp/postprocess.h>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./mglShader.hpp"
+
+namespace mgl {
+
+class ResourceManager;
+class Mesh;
+
+//////////////////////////////////////////////////////////////// ResourceManager
+//
+// Shares meshes and programs through reference-counted handles. Meshes are
+// identified by file and import flags, programs by name, so acquiring a
+// resource that is already loaded returns the same one. Resources no longer
+// referenced outside the manager stay cached, and collect() evicts the least
+// recently acquired of them while GPU memory is over budget. Variants of a
+// program, compiled with different defines, are cached apart. The GPU bytes
+// of the cache are kept as a running total, adjusted as programs are built,
+// meshes finish uploading and resources are evicted, so collect() costs
+// nothing while under budget.
+
+class ResourceManager {
+ public:
+  using MeshHandle = std::shared_ptr<Mesh>;
+  using ProgramHandle = std::shared_ptr<ShaderProgram>;
+  using ProgramBuilder = std::function<void(ShaderProgram &)>;
+
+  struct Usage {
+    std::size_t CpuBytes = 0;
+    std::size_t GpuBytes = 0;
+    unsigned int Resources = 0;
+    unsigned int Referenced = 0;
+  };
+
+  static ResourceManager &getInstance();
+
+  void setGpuBudget(std::size_t bytes);
+  std::size_t getGpuBudget() const;
+
+  MeshHandle acquireMesh(const std::string &filename,
+                         unsigned int flags = aiProcess_Triangulate);
+  ProgramHandle acquireProgram(const std::string &name,
+                               const ProgramBuilder &build);
+  ProgramHandle acquireProgram(const std::string &name,
+                               const ShaderDefines &defines,
+                               const ProgramBuilder &build);
+
+  void collect();
+  // Evicts every resource no longer referenced outside the manager, whatever
+  // the budget; those still referenced are kept.
+  void evictUnreferenced();
+  std::size_t getGpuBytes() const;
+  Usage getUsage() const;
+  void printReport(std::ostream &out) const;
+
+ private:
+  // gpuBytes is what the entry counts for in GpuBytes; a loading mesh does
+  // not count yet.
+  template <typename T> struct Entry {
+    std::shared_ptr<T> resource;
+    unsigned long long lastUse = 0;
+    std::size_t gpuBytes = 0;
+    bool loading = false;
+  };
+  using MeshKey = std::pair<std::string, unsigned int>;
+  using MeshMap = std::map<MeshKey, Entry<Mesh>>;
+  using ProgramMap = std::map<std::string, Entry<ShaderProgram>>;
+
+  MeshMap Meshes;
+  ProgramMap Programs;
+  std::vector<MeshKey> Loading;
+  std::size_t GpuBudget;
+  std::size_t GpuBytes;
+  unsigned long long Clock;
+
+  ResourceManager();
+  void accountUploads();
+  template <typename Map> void evict(Map &map, typename Map::iterator it);
+
+ public:
+  ResourceManager(ResourceManager const &) = delete;
+  void operator=(ResourceManager const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_RESOURCES_HPP */
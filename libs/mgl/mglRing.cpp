@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Streaming Upload Ring
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "./mglDeletionQueue.hpp"
+#include "./mglState.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// UploadRing
+
+static const GLbitfield RING_FLAGS =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+bool UploadRing::isSupported() {
+  return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+UploadRing::UploadRing(GLsizeiptr size) {
+  if (!isSupported()) {
+    std::cerr << "[ERROR] Upload ring needs OpenGL 4.4 or ARB_buffer_storage"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // Regions are aligned so that any of them can be bound as a uniform or a
+  // shader storage block.
+  GLint uniform = 0, storage = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform);
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage);
+  Alignment = std::max<GLsizeiptr>({uniform, storage, 16});
+  Size = size;
+  Head = 0;
+  Used = 0;
+  FrameBytes = 0;
+
+  if (GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access) {
+    glCreateBuffers(1, &BufferId);
+    glNamedBufferStorage(BufferId, Size, nullptr, RING_FLAGS);
+    Data = static_cast<unsigned char *>(
+        glMapNamedBufferRange(BufferId, 0, Size, RING_FLAGS));
+  } else {
+    StateCache &state = StateCache::getInstance();
+    glGenBuffers(1, &BufferId);
+    state.bindBuffer(GL_COPY_WRITE_BUFFER, BufferId);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, Size, nullptr, RING_FLAGS);
+    Data = static_cast<unsigned char *>(
+        glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, Size, RING_FLAGS));
+  }
+  if (!Data) {
+    std::cerr << "[ERROR] Could not map upload ring of " << Size << " bytes"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Deleting the buffer also unmaps it.
+UploadRing::~UploadRing() {
+  for (Frame &frame : Frames) {
+    glDeleteSync(frame.fence);
+  }
+  DeletionQueue::getInstance().deleteBuffer(BufferId);
+}
+
+GLuint UploadRing::getBuffer() const { return BufferId; }
+
+GLsizeiptr UploadRing::getSize() const { return Size; }
+
+GLsizeiptr UploadRing::getUsed() const { return Used; }
+
+UploadRing::Region UploadRing::allocate(GLsizeiptr size) {
+  return allocate(size, Alignment);
+}
+
+// The free space runs from Head to the start of the oldest region still in
+// use, wrapping around the end of the buffer. A region never wraps: when it
+// does not fit before the end, the rest of the buffer is skipped.
+UploadRing::Region UploadRing::allocate(GLsizeiptr size,
+                                        GLsizeiptr alignment) {
+  for (;;) {
+    GLsizeiptr offset = (Head + alignment - 1) / alignment * alignment;
+    if (offset + size > Size) {
+      offset = 0;
+    }
+    const GLsizeiptr needed =
+        offset >= Head ? offset - Head + size : Size - Head + size;
+    if (Used + needed <= Size) {
+      Head = offset + size;
+      Used += needed;
+      FrameBytes += needed;
+      return {BufferId, offset, size, Data + offset};
+    }
+    if (Frames.empty()) {
+      std::cerr << "[ERROR] Upload ring of " << Size
+                << " bytes cannot hold a frame needing " << Used + needed
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    retire(true);
+  }
+}
+
+UploadRing::Region UploadRing::write(const void *data, GLsizeiptr size) {
+  Region region = allocate(size);
+  std::memcpy(region.data, data, size);
+  return region;
+}
+
+void UploadRing::bindRange(GLenum target, GLuint index, const Region &region) {
+  StateCache::getInstance().bindBufferRange(target, index, region.buffer,
+                                            region.offset, region.size);
+}
+
+void UploadRing::endFrame() {
+  if (FrameBytes > 0) {
+    Frames.push_back(
+        {glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), FrameBytes});
+    FrameBytes = 0;
+  }
+  retire(false);
+}
+
+// Frees the regions of completed frames, oldest first. Only blocks when the
+// ring is full, in which case the oldest frame is waited for.
+void UploadRing::retire(bool wait) {
+  while (!Frames.empty()) {
+    Frame &frame = Frames.front();
+    GLenum status = glClientWaitSync(frame.fence, 0, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                1000000000);
+    }
+    if (status == GL_WAIT_FAILED) {
+      std::cerr << "[ERROR] Upload ring fence wait failed" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(frame.fence);
+    Used -= frame.bytes;
+    Frames.pop_front();
+    wait = false;
+  }
+  if (Used == 0) {
+    Head = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
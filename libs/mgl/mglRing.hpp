@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Streaming Upload Ring
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_RING_HPP
+#define MGL_RING_HPP
+
+#include <GL/glew.h>
+
+#include <deque>
+
+namespace mgl {
+
+class UploadRing;
+
+///////////////////////////////////////////////////////////////////// UploadRing
+//
+// A buffer with immutable storage that stays mapped, write-only and coherent,
+// for its whole lifetime. Data written each frame (dynamic vertices,
+// per-object data, uniform and storage blocks) is sub-allocated linearly from
+// it and read by the GPU in place, so no orphaning or glBufferSubData
+// synchronization is needed. The owner calls endFrame() once the draws
+// reading the frame's regions have been issued; those regions are then
+// fenced and only reused once the GPU has passed the fence. Regions are only
+// valid for the frame they were allocated in. Engine owns the ring that
+// per-frame data is streamed through; see Engine::getUploadRing().
+
+class UploadRing {
+ public:
+  struct Region {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+    void *data;
+  };
+
+  static bool isSupported();
+
+  explicit UploadRing(GLsizeiptr size);
+  ~UploadRing();
+  UploadRing(const UploadRing &) = delete;
+  UploadRing &operator=(const UploadRing &) = delete;
+
+  Region allocate(GLsizeiptr size);
+  Region allocate(GLsizeiptr size, GLsizeiptr alignment);
+  Region write(const void *data, GLsizeiptr size);
+  void bindRange(GLenum target, GLuint index, const Region &region);
+  void endFrame();
+
+  GLuint getBuffer() const;
+  GLsizeiptr getSize() const;
+  GLsizeiptr getUsed() const;
+
+ private:
+  struct Frame {
+    GLsync fence;
+    GLsizeiptr bytes;
+  };
+
+  GLuint BufferId;
+  unsigned char *Data;
+  GLsizeiptr Size;
+  GLsizeiptr Alignment;
+  GLsizeiptr Head;
+  GLsizeiptr Used;
+  GLsizeiptr FrameBytes;
+  std::deque<Frame> Frames;
+
+  void retire(bool wait);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_RING_HPP */
@@ -0,0 +1,597 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Scene Management Class
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglScenegraph.hpp"
+
+#include <algorithm>
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/simd/matrix.h>
+#include <iostream>
+
+#include "./mglCamera.hpp"
+#include "./mglConventions.hpp"
+#include "./mglMaterials.hpp"
+#include "./mglMesh.hpp"
+#include "./mglShader.hpp"
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////// UPDATE KERNELS
+
+// world = parent * T * R * S, or T * R * S for root nodes. With SIMD enabled
+// (GLM_FORCE_INTRINSICS) the local matrix is assembled in SSE registers and
+// concatenated with GLM's SSE matrix product.
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+static void composeWorldMatrix(const glm::mat4 *parent,
+                               const glm::vec3 &translation,
+                               const glm::quat &rotation,
+                               const glm::vec3 &scale, glm::mat4 &world) {
+  const glm::mat3 r = glm::mat3_cast(rotation);
+  glm_vec4 local[4];
+  local[0] = _mm_mul_ps(_mm_set_ps(0.0f, r[0][2], r[0][1], r[0][0]),
+                        _mm_set1_ps(scale.x));
+  local[1] = _mm_mul_ps(_mm_set_ps(0.0f, r[1][2], r[1][1], r[1][0]),
+                        _mm_set1_ps(scale.y));
+  local[2] = _mm_mul_ps(_mm_set_ps(0.0f, r[2][2], r[2][1], r[2][0]),
+                        _mm_set1_ps(scale.z));
+  local[3] = _mm_set_ps(1.0f, translation.z, translation.y, translation.x);
+
+  float *out = glm::value_ptr(world);
+  if (parent) {
+    const float *in = glm::value_ptr(*parent);
+    const glm_vec4 p[4] = {_mm_loadu_ps(in), _mm_loadu_ps(in + 4),
+                           _mm_loadu_ps(in + 8), _mm_loadu_ps(in + 12)};
+    glm_vec4 result[4];
+    glm_mat4_mul(p, local, result);
+    for (int c = 0; c < 4; c++) {
+      _mm_storeu_ps(out + 4 * c, result[c]);
+    }
+  } else {
+    for (int c = 0; c < 4; c++) {
+      _mm_storeu_ps(out + 4 * c, local[c]);
+    }
+  }
+}
+
+#else
+
+static void composeWorldMatrix(const glm::mat4 *parent,
+                               const glm::vec3 &translation,
+                               const glm::quat &rotation,
+                               const glm::vec3 &scale, glm::mat4 &world) {
+  const glm::mat4 local = glm::translate(translation) *
+                          glm::mat4_cast(rotation) * glm::scale(scale);
+  world = parent ? *parent * local : local;
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////// CULLING KERNELS
+
+// A box is outside when it lies entirely behind one of the frustum planes,
+// i.e. when the signed distance of its center plus its projected radius
+// (|n| . extent) is negative. Boxes are stored as separate center and extent
+// arrays so that the SSE path tests four boxes per plane per instruction.
+
+static bool isBoxVisible(const glm::vec4 *planes, const glm::vec3 &center,
+                         const glm::vec3 &extent) {
+  for (int p = 0; p < 6; p++) {
+    const glm::vec3 n(planes[p]);
+    const float d = glm::dot(n, center) + planes[p].w;
+    const float r = glm::dot(glm::abs(n), extent);
+    if (d + r < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void cullBoxes(const glm::vec4 *planes, const float *cx,
+                      const float *cy, const float *cz, const float *ex,
+                      const float *ey, const float *ez, std::size_t n,
+                      unsigned char *visible) {
+  std::size_t i = 0;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 x = _mm_loadu_ps(cx + i);
+    const __m128 y = _mm_loadu_ps(cy + i);
+    const __m128 z = _mm_loadu_ps(cz + i);
+    const __m128 hx = _mm_loadu_ps(ex + i);
+    const __m128 hy = _mm_loadu_ps(ey + i);
+    const __m128 hz = _mm_loadu_ps(ez + i);
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++) {
+      const __m128 px = _mm_set1_ps(planes[p].x);
+      const __m128 py = _mm_set1_ps(planes[p].y);
+      const __m128 pz = _mm_set1_ps(planes[p].z);
+      const __m128 d = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(px, x), _mm_mul_ps(py, y)),
+          _mm_add_ps(_mm_mul_ps(pz, z), _mm_set1_ps(planes[p].w)));
+      const __m128 r = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, px), hx),
+                     _mm_mul_ps(_mm_andnot_ps(sign_mask, py), hy)),
+          _mm_mul_ps(_mm_andnot_ps(sign_mask, pz), hz));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+    }
+    const int mask = _mm_movemask_ps(inside);
+    visible[i + 0] = (mask >> 0) & 1;
+    visible[i + 1] = (mask >> 1) & 1;
+    visible[i + 2] = (mask >> 2) & 1;
+    visible[i + 3] = (mask >> 3) & 1;
+  }
+#endif
+  for (; i < n; i++) {
+    visible[i] = isBoxVisible(planes, glm::vec3(cx[i], cy[i], cz[i]),
+                              glm::vec3(ex[i], ey[i], ez[i]));
+  }
+}
+
+///////////////////////////////////////////////////////////////////// SceneGraph
+
+const unsigned int SceneGraph::NONE;
+
+SceneGraph::SceneGraph() {
+  FrustumCamera = nullptr;
+  Materials = nullptr;
+  DirtyCount = 0;
+  FirstDirty = 0;
+  OrderDirty = false;
+}
+
+unsigned int SceneGraph::addMesh(Mesh *mesh) {
+  MeshTable.push_back(mesh);
+  MeshReady.push_back(mesh->isReady() ? 1 : 0);
+  MeshMaterialBases.push_back(NONE);
+  MeshMaterialCounts.push_back(0);
+  if (MeshReady.back()) {
+    addMeshMaterials(MeshTable.size() - 1);
+  }
+  return static_cast<unsigned int>(MeshTable.size() - 1);
+}
+
+unsigned int SceneGraph::addMaterial(ShaderProgram *shader) {
+  Material material;
+  material.Shader = shader;
+  material.ProgramIndex = static_cast<unsigned int>(
+      std::find(ProgramTable.begin(), ProgramTable.end(), shader) -
+      ProgramTable.begin());
+  if (material.ProgramIndex == ProgramTable.size()) {
+    ProgramTable.push_back(shader);
+  }
+  // Locations are resolved once here; draws only use them.
+  material.ModelMatrixId = shader->getUniformLocation(MODEL_MATRIX);
+  material.PaletteBaseId = shader->getUniformLocation(PALETTE_BASE);
+  material.MorphBaseId = shader->getUniformLocation(MORPH_BASE);
+  material.MorphWeightBaseId = shader->getUniformLocation(MORPH_WEIGHT_BASE);
+  MaterialTable.push_back(material);
+  return static_cast<unsigned int>(MaterialTable.size() - 1);
+}
+
+// Meshes already ready have their materials added right away.
+void SceneGraph::setMaterialBuffer(MaterialBuffer *materials) {
+  Materials = materials;
+  std::fill(MeshMaterialBases.begin(), MeshMaterialBases.end(), NONE);
+  std::fill(MeshMaterialCounts.begin(), MeshMaterialCounts.end(), 0);
+  for (std::size_t m = 0; m < MeshTable.size(); m++) {
+    if (MeshReady[m]) {
+      addMeshMaterials(m);
+    }
+  }
+}
+
+// A reloaded mesh overwrites its previous block if it still fits there.
+void SceneGraph::addMeshMaterials(std::size_t mesh) {
+  if (!Materials) {
+    return;
+  }
+  const std::vector<MaterialData> &materials = MeshTable[mesh]->getMaterials();
+  if (MeshMaterialBases[mesh] != NONE &&
+      materials.size() <= MeshMaterialCounts[mesh]) {
+    for (std::size_t i = 0; i < materials.size(); i++) {
+      Materials->set(static_cast<unsigned int>(MeshMaterialBases[mesh] + i),
+                     materials[i]);
+    }
+  } else {
+    MeshMaterialBases[mesh] = Materials->add(materials);
+    MeshMaterialCounts[mesh] = materials.size();
+  }
+}
+
+unsigned int SceneGraph::addNode(unsigned int parent) {
+  if (parent != NONE && parent >= Slots.size()) {
+    std::cerr << "[ERROR] Invalid parent node " << parent << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  const unsigned int node = static_cast<unsigned int>(Slots.size());
+  const unsigned int slot = static_cast<unsigned int>(Ids.size());
+  const unsigned int parent_slot = parent == NONE ? NONE : Slots[parent];
+  const unsigned int depth = parent == NONE ? 0 : Depths[parent_slot] + 1;
+
+  // Appending keeps slots sorted as long as depths do not decrease.
+  if (!Depths.empty() && Depths.back() > depth) {
+    OrderDirty = true;
+  }
+
+  Slots.push_back(slot);
+  Ids.push_back(node);
+  Parents.push_back(parent_slot);
+  Depths.push_back(depth);
+  Translations.push_back(glm::vec3(0.0f));
+  Rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  Scales.push_back(glm::vec3(1.0f));
+  WorldMatrices.push_back(glm::mat4(1.0f));
+  MaterialBases.push_back(NONE);
+  PaletteBases.push_back(0);
+  MorphBases.push_back(NONE);
+  MorphWeightBases.push_back(0);
+  MeshIds.push_back(NONE);
+  MaterialIds.push_back(NONE);
+  Dirty.push_back(0);
+  BoundsCenterX.push_back(0.0f);
+  BoundsCenterY.push_back(0.0f);
+  BoundsCenterZ.push_back(0.0f);
+  BoundsExtentX.push_back(0.0f);
+  BoundsExtentY.push_back(0.0f);
+  BoundsExtentZ.push_back(0.0f);
+  Visible.push_back(1);
+  setDirty(slot);
+  return node;
+}
+
+void SceneGraph::setParent(unsigned int node, unsigned int parent) {
+  const unsigned int slot = Slots[node];
+  const unsigned int parent_slot = parent == NONE ? NONE : Slots[parent];
+  for (unsigned int p = parent_slot; p != NONE; p = Parents[p]) {
+    if (p == slot) {
+      std::cerr << "[ERROR] Node " << node << " cannot be parented to its "
+                << "own descendant " << parent << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  Parents[slot] = parent_slot;
+  refreshDepths();
+  OrderDirty = true;
+  setDirty(slot);
+}
+
+unsigned int SceneGraph::getParent(unsigned int node) const {
+  const unsigned int parent_slot = Parents[Slots[node]];
+  return parent_slot == NONE ? NONE : Ids[parent_slot];
+}
+
+unsigned int SceneGraph::getDepth(unsigned int node) const {
+  return Depths[Slots[node]];
+}
+
+std::size_t SceneGraph::size() const { return Slots.size(); }
+
+void SceneGraph::clear() {
+  Slots.clear();
+  Ids.clear();
+  Parents.clear();
+  Depths.clear();
+  Translations.clear();
+  Rotations.clear();
+  Scales.clear();
+  WorldMatrices.clear();
+  MaterialBases.clear();
+  PaletteBases.clear();
+  MorphBases.clear();
+  MorphWeightBases.clear();
+  MeshIds.clear();
+  MaterialIds.clear();
+  Dirty.clear();
+  BoundsCenterX.clear();
+  BoundsCenterY.clear();
+  BoundsCenterZ.clear();
+  BoundsExtentX.clear();
+  BoundsExtentY.clear();
+  BoundsExtentZ.clear();
+  Visible.clear();
+  DirtyCount = 0;
+  FirstDirty = 0;
+  OrderDirty = false;
+}
+
+void SceneGraph::setMesh(unsigned int node, unsigned int mesh) {
+  const unsigned int slot = Slots[node];
+  MeshIds[slot] = mesh;
+  setDirty(slot);
+}
+
+void SceneGraph::setMaterial(unsigned int node, unsigned int material) {
+  MaterialIds[Slots[node]] = material;
+}
+
+void SceneGraph::setMaterialBase(unsigned int node, unsigned int base) {
+  MaterialBases[Slots[node]] = base;
+}
+
+void SceneGraph::setPaletteBase(unsigned int node, unsigned int base) {
+  PaletteBases[Slots[node]] = base;
+}
+
+void SceneGraph::setMorphBase(unsigned int node, unsigned int base,
+                              unsigned int weightBase) {
+  const unsigned int slot = Slots[node];
+  MorphBases[slot] = base;
+  MorphWeightBases[slot] = weightBase;
+}
+
+void SceneGraph::setTranslation(unsigned int node,
+                                const glm::vec3 &translation) {
+  const unsigned int slot = Slots[node];
+  Translations[slot] = translation;
+  setDirty(slot);
+}
+
+void SceneGraph::setRotation(unsigned int node, const glm::quat &rotation) {
+  const unsigned int slot = Slots[node];
+  Rotations[slot] = rotation;
+  setDirty(slot);
+}
+
+void SceneGraph::setScale(unsigned int node, const glm::vec3 &scale) {
+  const unsigned int slot = Slots[node];
+  Scales[slot] = scale;
+  setDirty(slot);
+}
+
+void SceneGraph::setTransform(unsigned int node, const glm::vec3 &translation,
+                              const glm::quat &rotation,
+                              const glm::vec3 &scale) {
+  const unsigned int slot = Slots[node];
+  Translations[slot] = translation;
+  Rotations[slot] = rotation;
+  Scales[slot] = scale;
+  setDirty(slot);
+}
+
+const glm::mat4 &SceneGraph::getWorldMatrix(unsigned int node) const {
+  return WorldMatrices[Slots[node]];
+}
+
+void SceneGraph::setCamera(const Camera *camera) { FrustumCamera = camera; }
+
+bool SceneGraph::isVisible(unsigned int node) const {
+  return Visible[Slots[node]] != 0;
+}
+
+void SceneGraph::setDirty(unsigned int slot) {
+  if (!Dirty[slot]) {
+    Dirty[slot] = 1;
+    if (DirtyCount == 0 || slot < FirstDirty) {
+      FirstDirty = slot;
+    }
+    DirtyCount++;
+  }
+}
+
+void SceneGraph::refreshDepths() {
+  for (unsigned int i = 0; i < Parents.size(); i++) {
+    unsigned int depth = 0;
+    for (unsigned int p = Parents[i]; p != NONE; p = Parents[p]) {
+      depth++;
+    }
+    Depths[i] = depth;
+  }
+}
+
+template <typename T>
+void SceneGraph::permute(std::vector<T> &v,
+                         const std::vector<unsigned int> &order) {
+  std::vector<T> sorted(v.size());
+  for (unsigned int i = 0; i < order.size(); i++) {
+    sorted[i] = v[order[i]];
+  }
+  v.swap(sorted);
+}
+
+void SceneGraph::sortSlots() {
+  // Counting sort on depth, stable with respect to the current slot order.
+  const unsigned int max_depth = *std::max_element(Depths.begin(), Depths.end());
+  std::vector<unsigned int> offsets(max_depth + 2, 0);
+  for (unsigned int depth : Depths) {
+    offsets[depth + 1]++;
+  }
+  for (unsigned int d = 1; d < offsets.size(); d++) {
+    offsets[d] += offsets[d - 1];
+  }
+  std::vector<unsigned int> order(Ids.size());
+  std::vector<unsigned int> new_slots(Ids.size());
+  for (unsigned int i = 0; i < Ids.size(); i++) {
+    const unsigned int slot = offsets[Depths[i]]++;
+    order[slot] = i;
+    new_slots[i] = slot;
+  }
+
+  permute(Ids, order);
+  permute(Parents, order);
+  permute(Depths, order);
+  permute(Translations, order);
+  permute(Rotations, order);
+  permute(Scales, order);
+  permute(WorldMatrices, order);
+  permute(MaterialBases, order);
+  permute(PaletteBases, order);
+  permute(MorphBases, order);
+  permute(MorphWeightBases, order);
+  permute(MeshIds, order);
+  permute(MaterialIds, order);
+  permute(Dirty, order);
+  permute(BoundsCenterX, order);
+  permute(BoundsCenterY, order);
+  permute(BoundsCenterZ, order);
+  permute(BoundsExtentX, order);
+  permute(BoundsExtentY, order);
+  permute(BoundsExtentZ, order);
+  permute(Visible, order);
+  for (unsigned int &parent : Parents) {
+    parent = parent == NONE ? NONE : new_slots[parent];
+  }
+  for (unsigned int &slot : Slots) {
+    slot = new_slots[slot];
+  }
+  FirstDirty = 0;
+  OrderDirty = false;
+}
+
+// Nodes of a mesh that finished loading since the last update are dirtied,
+// so that their world bounds are computed from the loaded mesh.
+void SceneGraph::refreshMeshes() {
+  for (std::size_t m = 0; m < MeshTable.size(); m++) {
+    const unsigned char ready = MeshTable[m]->isReady() ? 1 : 0;
+    if (ready == MeshReady[m]) {
+      continue;
+    }
+    MeshReady[m] = ready;
+    if (ready) {
+      addMeshMaterials(m);
+    }
+    for (unsigned int i = 0; i < MeshIds.size(); i++) {
+      if (MeshIds[i] == m) {
+        setDirty(i);
+      }
+    }
+  }
+}
+
+void SceneGraph::update() {
+  refreshMeshes();
+  if (OrderDirty) {
+    sortSlots();
+  }
+  if (DirtyCount == 0) {
+    return;
+  }
+  // Slots before the first dirty one cannot change. Past it, a node is
+  // recomputed if it is dirty or its parent was recomputed in this sweep,
+  // which the dirty flag of the parent records until the sweep ends.
+  const std::size_t n = Ids.size();
+  for (std::size_t i = FirstDirty; i < n; i++) {
+    const unsigned int parent = Parents[i];
+    if (Dirty[i] || (parent != NONE && Dirty[parent])) {
+      Dirty[i] = 1;
+      composeWorldMatrix(parent == NONE ? nullptr : &WorldMatrices[parent],
+                         Translations[i], Rotations[i], Scales[i],
+                         WorldMatrices[i]);
+      if (MeshIds[i] != NONE && MeshReady[MeshIds[i]]) {
+        updateWorldBounds(i);
+      }
+    }
+  }
+  std::fill(Dirty.begin() + FirstDirty, Dirty.end(), 0);
+  DirtyCount = 0;
+}
+
+void SceneGraph::updateWorldBounds(std::size_t slot) {
+  // Transformed AABB: the center is transformed as a point and each world
+  // extent is the sum of the local extents weighted by |M|.
+  const Bounds &bounds = MeshTable[MeshIds[slot]]->getBounds();
+  const glm::mat4 &m = WorldMatrices[slot];
+  const glm::vec3 center = glm::vec3(m * glm::vec4(bounds.center, 1.0f));
+  const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+  const glm::mat3 a(glm::abs(glm::vec3(m[0])), glm::abs(glm::vec3(m[1])),
+                    glm::abs(glm::vec3(m[2])));
+  const glm::vec3 world_extent = a * extent;
+  BoundsCenterX[slot] = center.x;
+  BoundsCenterY[slot] = center.y;
+  BoundsCenterZ[slot] = center.z;
+  BoundsExtentX[slot] = world_extent.x;
+  BoundsExtentY[slot] = world_extent.y;
+  BoundsExtentZ[slot] = world_extent.z;
+}
+
+void SceneGraph::cull() {
+  if (!FrustumCamera) {
+    std::fill(Visible.begin(), Visible.end(), 1);
+    return;
+  }
+  cullBoxes(FrustumCamera->getFrustumPlanes(), BoundsCenterX.data(),
+            BoundsCenterY.data(), BoundsCenterZ.data(), BoundsExtentX.data(),
+            BoundsExtentY.data(), BoundsExtentZ.data(), Ids.size(),
+            Visible.data());
+}
+
+void SceneGraph::buildQueue() {
+  Queue.clear();
+  glm::mat4 view_matrix(1.0f);
+  if (FrustumCamera) {
+    view_matrix = FrustumCamera->getViewMatrix();
+  }
+  const glm::vec4 view_z = glm::row(view_matrix, 2);
+  for (std::size_t i = 0; i < Ids.size(); i++) {
+    if (!Visible[i] || MeshIds[i] == NONE || MaterialIds[i] == NONE ||
+        !MeshReady[MeshIds[i]]) {
+      continue;
+    }
+    const Material &material = MaterialTable[MaterialIds[i]];
+    const Mesh *mesh = MeshTable[MeshIds[i]];
+    const glm::vec4 center(BoundsCenterX[i], BoundsCenterY[i],
+                           BoundsCenterZ[i], 1.0f);
+    const float depth = -glm::dot(view_z, center);
+    Queue.push(RenderQueue::makeKey(material.ProgramIndex,
+                                    mesh->getVertexFormat(), MeshIds[i],
+                                    depth),
+               static_cast<unsigned int>(i));
+  }
+  Queue.sort();
+}
+
+void SceneGraph::draw() {
+  update();
+  cull();
+  buildQueue();
+  if (Materials) {
+    Materials->upload();
+  }
+
+  ShaderProgram *bound_shader = nullptr;
+  Mesh *bound_mesh = nullptr;
+  for (std::size_t q = 0; q < Queue.size(); q++) {
+    const unsigned int i = Queue[q].item;
+    const Material &material = MaterialTable[MaterialIds[i]];
+    Mesh *mesh = MeshTable[MeshIds[i]];
+    if (material.Shader != bound_shader) {
+      material.Shader->bind();
+      bound_shader = material.Shader;
+    }
+    if (mesh != bound_mesh) {
+      mesh->bind();
+      bound_mesh = mesh;
+    }
+    if (material.PaletteBaseId >= 0) {
+      glUniform1ui(material.PaletteBaseId, PaletteBases[i]);
+    }
+    if (material.MorphBaseId >= 0) {
+      glUniform1ui(material.MorphBaseId, MorphBases[i]);
+    }
+    if (material.MorphWeightBaseId >= 0) {
+      glUniform1ui(material.MorphWeightBaseId, MorphWeightBases[i]);
+    }
+    if (MaterialBases[i] != NONE) {
+      mesh->drawElements(material.ModelMatrixId, WorldMatrices[i],
+                         MaterialBases[i], true);
+    } else {
+      const unsigned int material_base = MeshMaterialBases[MeshIds[i]];
+      mesh->drawElements(material.ModelMatrixId, WorldMatrices[i],
+                         material_base == NONE ? 0 : material_base);
+    }
+  }
+  // Nothing is unbound: the state cache skips the first binds of the next
+  // frame when they match the last ones of this frame.
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
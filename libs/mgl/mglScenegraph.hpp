@@ -9,9 +9,22 @@
 #ifndef MGL_SCENEGRAPH_HPP
 #define MGL_SCENEGRAPH_HPP
 
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+#include "./mglRenderQueue.hpp"
+
 namespace mgl {
 
 class IDrawable;
+class SceneGraph;
+class Camera;
+class Mesh;
+class MaterialBuffer;
+class ShaderProgram;
 
 ////////////////////////////////////////////////////////////////////// IDrawable
 
@@ -20,6 +33,128 @@ class IDrawable {
   virtual void draw(void) = 0;
 };
 
+///////////////////////////////////////////////////////////////////// SceneGraph
+//
+// Scene nodes stored as structure-of-arrays. Every per-node attribute lives in
+// its own contiguous array, indexed by a slot. Slots are kept sorted by depth,
+// so a parent always precedes its children and the transform update is a
+// single linear sweep. Node ids returned to the caller stay stable across
+// the re-sorting. World matrices are recomputed only for dirty subtrees.
+// When a camera is set, world-space bounding boxes are tested against its
+// frustum four at a time and nodes outside it are not submitted. Visible
+// draws go through a RenderQueue, so programs and vertex arrays are bound
+// once per run of draws sharing them rather than once per node. Nodes whose
+// mesh is still loading are skipped, and their bounds are refreshed once it
+// becomes ready.
+//
+// With a material buffer set, the materials of each mesh are added to it when
+// the mesh becomes ready, and each draw passes the index of the node's first
+// material. A node may instead draw every submesh with one material of its
+// own, to recolor a shared mesh.
+//
+// Skinned nodes give where their palette starts in the palette buffer, which
+// is passed to programs that declare the PaletteBase uniform.
+//
+// Morphed nodes give where their mesh's targets and their own weights start
+// in the morph buffer, passed as the MorphBase and MorphWeightBase uniforms.
+// Nodes without targets pass NONE as their morph base.
+
+class SceneGraph : public IDrawable {
+ public:
+  static const unsigned int NONE = ~0u;
+
+  SceneGraph();
+
+  unsigned int addMesh(Mesh *mesh);
+  unsigned int addMaterial(ShaderProgram *shader);
+  void setMaterialBuffer(MaterialBuffer *materials);
+
+  unsigned int addNode(unsigned int parent = NONE);
+  void setParent(unsigned int node, unsigned int parent);
+  unsigned int getParent(unsigned int node) const;
+  unsigned int getDepth(unsigned int node) const;
+  std::size_t size() const;
+  void clear();
+
+  void setMesh(unsigned int node, unsigned int mesh);
+  void setMaterial(unsigned int node, unsigned int material);
+  // The index of the material table entry every submesh of the node is drawn
+  // with. It is absolute: the submesh's own material index is not added.
+  // NONE draws the node with the materials of its mesh.
+  void setMaterialBase(unsigned int node, unsigned int base);
+  void setPaletteBase(unsigned int node, unsigned int base);
+  void setMorphBase(unsigned int node, unsigned int base,
+                    unsigned int weightBase);
+  void setTranslation(unsigned int node, const glm::vec3 &translation);
+  void setRotation(unsigned int node, const glm::quat &rotation);
+  void setScale(unsigned int node, const glm::vec3 &scale);
+  void setTransform(unsigned int node, const glm::vec3 &translation,
+                    const glm::quat &rotation, const glm::vec3 &scale);
+  const glm::mat4 &getWorldMatrix(unsigned int node) const;
+
+  void setCamera(const Camera *camera);
+  bool isVisible(unsigned int node) const;
+
+  void update();
+  void draw() override;
+
+ private:
+  struct Material {
+    ShaderProgram *Shader;
+    unsigned int ProgramIndex;
+    GLint ModelMatrixId;
+    GLint PaletteBaseId;
+    GLint MorphBaseId;
+    GLint MorphWeightBaseId;
+  };
+  std::vector<Mesh *> MeshTable;
+  std::vector<unsigned char> MeshReady;
+  std::vector<unsigned int> MeshMaterialBases;
+  std::vector<std::size_t> MeshMaterialCounts;
+  MaterialBuffer *Materials;
+  std::vector<Material> MaterialTable;
+  std::vector<ShaderProgram *> ProgramTable;
+  RenderQueue Queue;
+  const Camera *FrustumCamera;
+
+  // Indexed by node id.
+  std::vector<unsigned int> Slots;
+
+  // Indexed by slot.
+  std::vector<unsigned int> Ids;
+  std::vector<unsigned int> Parents;
+  std::vector<unsigned int> Depths;
+  std::vector<glm::vec3> Translations;
+  std::vector<glm::quat> Rotations;
+  std::vector<glm::vec3> Scales;
+  std::vector<glm::mat4> WorldMatrices;
+  std::vector<unsigned int> MaterialBases;
+  std::vector<unsigned int> PaletteBases;
+  std::vector<unsigned int> MorphBases;
+  std::vector<unsigned int> MorphWeightBases;
+  std::vector<unsigned int> MeshIds;
+  std::vector<unsigned int> MaterialIds;
+  std::vector<unsigned char> Dirty;
+  std::vector<float> BoundsCenterX, BoundsCenterY, BoundsCenterZ;
+  std::vector<float> BoundsExtentX, BoundsExtentY, BoundsExtentZ;
+  std::vector<unsigned char> Visible;
+
+  unsigned int DirtyCount;
+  unsigned int FirstDirty;
+  bool OrderDirty;
+
+  void setDirty(unsigned int slot);
+  void refreshMeshes();
+  void addMeshMaterials(std::size_t mesh);
+  void refreshDepths();
+  void sortSlots();
+  void updateWorldBounds(std::size_t slot);
+  void cull();
+  void buildQueue();
+  template <typename T>
+  void permute(std::vector<T> &v, const std::vector<unsigned int> &order);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
 
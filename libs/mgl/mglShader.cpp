@@ -8,25 +8,131 @@
 
 #include "./mglShader.hpp"
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
+#include <set>
 #include <vector>
 
+#include "./mglDeletionQueue.hpp"
+#include "./mglPack.hpp"
+#include "./mglState.hpp"
+
 namespace mgl {
 
+/////////////////////////////////////////////////////////////////// PREPROCESSOR
+
+struct PreprocessedSource {
+  std::vector<std::string> Files;
+  std::set<std::string> Included;
+  std::string Text;
+  std::size_t VersionEnd = 0;
+  unsigned int VersionLine = 0;
+};
+
+static std::string_view skipBlanks(std::string_view text) {
+  std::size_t i = 0;
+  while (i < text.size() && (text[i] == ' ' || text[i] == '\t')) {
+    i++;
+  }
+  return text.substr(i);
+}
+
+static bool isDirective(std::string_view line, std::string_view directive,
+                        std::string_view &arguments) {
+  line = skipBlanks(line);
+  if (line.empty() || line[0] != '#') {
+    return false;
+  }
+  line = skipBlanks(line.substr(1));
+  if (line.compare(0, directive.size(), directive) != 0) {
+    return false;
+  }
+  arguments = skipBlanks(line.substr(directive.size()));
+  return true;
+}
+
+static std::string directoryOf(const std::string &filename) {
+  const std::size_t slash = filename.find_last_of("/\\");
+  return slash == std::string::npos ? std::string()
+                                    : filename.substr(0, slash + 1);
+}
+
+static void expand(PreprocessedSource &out, std::size_t file,
+                   std::string_view text) {
+  unsigned int line_number = 0;
+  std::size_t p = 0;
+  while (p < text.size()) {
+    const std::size_t eol = std::min(text.find('\n', p), text.size());
+    const std::string_view line = text.substr(p, eol - p);
+    p = eol + 1;
+    line_number++;
+    std::string_view name;
+    if (isDirective(line, "include", name)) {
+      const char close = name.empty() ? 0 : name[0] == '<' ? '>' : name[0];
+      const std::size_t end = close == '"' || close == '>'
+                                  ? name.find(close, 1)
+                                  : std::string_view::npos;
+      if (end == std::string_view::npos) {
+        std::cerr << "[ERROR] " << out.Files[file] << ":" << line_number
+                  << ": malformed #include" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      const std::string path =
+          directoryOf(out.Files[file]) + std::string(name.substr(1, end - 1));
+      if (out.Included.insert(path).second) {
+        AssetFile source;
+        if (!source.open(path)) {
+          std::cerr << "[ERROR] " << out.Files[file] << ":" << line_number
+                    << ": failed to open shader include: " << path
+                    << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        out.Files.push_back(path);
+        const std::size_t included = out.Files.size() - 1;
+        out.Text += "#line 1 " + std::to_string(included) + "\n";
+        expand(out, included, source.view());
+        out.Text += "#line " + std::to_string(line_number + 1) + " " +
+                    std::to_string(file) + "\n";
+      } else {
+        out.Text += "\n";
+      }
+      continue;
+    }
+    out.Text.append(line.data(), line.size());
+    out.Text += "\n";
+    if (file == 0 && out.VersionLine == 0 &&
+        isDirective(line, "version", name)) {
+      out.VersionEnd = out.Text.size();
+      out.VersionLine = line_number;
+    }
+  }
+}
+
+// Defines go after #version, which must come first, or else at the top.
+static void insertDefines(PreprocessedSource &out,
+                          const ShaderDefines &defines) {
+  if (defines.empty()) {
+    return;
+  }
+  std::string text;
+  for (const auto &define : defines) {
+    text += "#define " + define.first;
+    text += define.second.empty() ? "\n" : " " + define.second + "\n";
+  }
+  text += "#line " + std::to_string(out.VersionLine + 1) + " 0\n";
+  out.Text.insert(out.VersionEnd, text);
+}
+
 ////////////////////////////////////////////////////////////////// ShaderProgram
 
-const std::string ShaderProgram::read(const std::string &filename) {
-  std::string line, shader_string;
-  std::ifstream ifile(filename);
-  if (!ifile.is_open()) {
+// Sources are read in place from a mounted pack or the mapped file.
+std::string_view ShaderProgram::read(const std::string &filename,
+                                     AssetFile &file) {
+  if (!file.open(filename)) {
     std::cerr << "[ERROR] Failed to open shader file: " << filename;
     exit(EXIT_FAILURE);
   }
-  while (std::getline(ifile, line)) {
-    shader_string += line + "\n";
-  }
-  return shader_string;
+  return file.view();
 }
 
 void ShaderProgram::checkCompilation(const GLuint shader_id,
@@ -56,61 +162,97 @@ void ShaderProgram::checkLinkage() {
   }
 }
 
-ShaderProgram::ShaderProgram() : ProgramId(glCreateProgram()) {}
+ShaderProgram::ShaderProgram() : ProgramId(glCreateProgram()), GpuBytes(0) {}
 
 ShaderProgram::~ShaderProgram() {
-  glUseProgram(0);
-  glDeleteProgram(ProgramId);
+  DeletionQueue::getInstance().deleteProgram(ProgramId);
+}
+
+// Must be called before shaders are added.
+void ShaderProgram::setDefines(const ShaderDefines &defines) {
+  Defines = defines;
 }
 
+const ShaderDefines &ShaderProgram::getDefines() const { return Defines; }
+
 void ShaderProgram::addShader(const GLenum shader_type,
                               const std::string &filename) {
+  AssetFile file;
+  addShaderSource(shader_type, filename, read(filename, file));
+}
+
+// Includes of a source given in memory are found relative to its name.
+// Sources with nothing to preprocess are compiled in place.
+void ShaderProgram::addShaderSource(const GLenum shader_type,
+                                    const std::string &name,
+                                    std::string_view source) {
+  if (Defines.empty() && source.find("#include") == std::string_view::npos) {
+    compile(shader_type, name, source);
+    return;
+  }
+  PreprocessedSource out;
+  out.Files.push_back(name);
+  out.Included.insert(name);
+  out.Text.reserve(source.size());
+  expand(out, 0, source);
+  insertDefines(out, Defines);
+  std::string files = name;
+  for (std::size_t i = 1; i < out.Files.size(); i++) {
+    files += (i == 1 ? " (" : ", ") + std::to_string(i) + ": " + out.Files[i];
+  }
+  compile(shader_type, out.Files.size() > 1 ? files + ")" : files, out.Text);
+}
+
+void ShaderProgram::compile(const GLenum shader_type, const std::string &name,
+                            std::string_view source) {
   const GLuint shader_id = glCreateShader(shader_type);
-  const std::string scode = read(filename);
-  const GLchar *code = scode.c_str();
-  glShaderSource(shader_id, 1, &code, 0);
+  const GLchar *code = source.empty() ? "" : source.data();
+  const GLint length = static_cast<GLint>(source.size());
+  glShaderSource(shader_id, 1, &code, &length);
   glCompileShader(shader_id);
-  checkCompilation(shader_id, filename);
+  checkCompilation(shader_id, name);
   glAttachShader(ProgramId, shader_id);
 
   Shaders[shader_type] = {shader_id};
 }
 
 void ShaderProgram::addAttribute(const std::string &name, const GLuint index) {
-  if (isAttribute(name)) {
-    std::cerr << "[WARNING] Attribute " << name << " already exists"
-              << std::endl;
+  for (const Binding &binding : AttributeBindings) {
+    if (binding.Name == name) {
+      std::cerr << "[WARNING] Attribute " << name << " already exists"
+                << std::endl;
+    }
   }
   glBindAttribLocation(ProgramId, index, name.c_str());
-  Attributes[name] = {index};
-}
-
-bool ShaderProgram::isAttribute(const std::string &name) {
-  return Attributes.find(name) != Attributes.end();
+  AttributeBindings.push_back({name, index});
 }
 
+// Optional, as uniforms are found by create(), which warns if this one is
+// not among them.
 void ShaderProgram::addUniform(const std::string &name) {
-  if (isUniform(name)) {
-    std::cerr << "[WARNING] Uniform " << name << " already exists" << std::endl;
-  }
-  Uniforms[name] = {-1};
-}
-
-bool ShaderProgram::isUniform(const std::string &name) {
-  return Uniforms.find(name) != Uniforms.end();
+  ExpectedUniforms.push_back(name);
 }
 
 void ShaderProgram::addUniformBlock(const std::string &name,
                                     const GLuint binding_point) {
-  if (isUniformBlock(name)) {
-    std::cerr << "[WARNING] Uniform block " << name << " already exists"
-              << std::endl;
+  for (const Binding &binding : UniformBlockBindings) {
+    if (binding.Name == name) {
+      std::cerr << "[WARNING] Uniform block " << name << " already exists"
+                << std::endl;
+    }
   }
-  Ubos[name] = {0, binding_point};
+  UniformBlockBindings.push_back({name, binding_point});
 }
 
-bool ShaderProgram::isUniformBlock(const std::string &name) {
-  return Ubos.find(name) != Ubos.end();
+void ShaderProgram::addStorageBlock(const std::string &name,
+                                    const GLuint binding_point) {
+  for (const Binding &binding : StorageBlockBindings) {
+    if (binding.Name == name) {
+      std::cerr << "[WARNING] Storage block " << name << " already exists"
+                << std::endl;
+    }
+  }
+  StorageBlockBindings.push_back({name, binding_point});
 }
 
 void ShaderProgram::create() {
@@ -120,23 +262,165 @@ void ShaderProgram::create() {
     glDetachShader(ProgramId, i.second);
     glDeleteShader(i.second);
   }
+  // Estimated from the size of the linked binary, when the driver reports it.
+  GLint length = 0;
+  if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+    glGetProgramiv(ProgramId, GL_PROGRAM_BINARY_LENGTH, &length);
+  }
+  GpuBytes = static_cast<std::size_t>(length);
 
-  for (auto &i : Uniforms) {
-    i.second.index = glGetUniformLocation(ProgramId, i.first.c_str());
-    if (i.second.index < 0)
-      std::cerr << "WARNING: Uniform " << i.first << " not found." << std::endl;
+  reflect(ATTRIBUTE);
+  reflect(UNIFORM);
+  reflect(UNIFORM_BLOCK);
+  reflect(STORAGE_BLOCK);
+  for (const std::string &name : ExpectedUniforms) {
+    if (!isUniform(name)) {
+      std::cerr << "WARNING: Uniform " << name << " not found." << std::endl;
+    }
   }
-  for (auto &i : Ubos) {
-    i.second.index = glGetUniformBlockIndex(ProgramId, i.first.c_str());
-    if (i.second.index == GL_INVALID_INDEX)
-      std::cerr << "WARNING: UBO " << i.first << " not found." << std::endl;
-    glUniformBlockBinding(ProgramId, i.second.index, i.second.binding_point);
+  bindBlocks(UNIFORM_BLOCK, UniformBlockBindings);
+  bindBlocks(STORAGE_BLOCK, StorageBlockBindings);
+}
+
+// Measured once by create(), so it costs no query.
+std::size_t ShaderProgram::getGpuBytes() const { return GpuBytes; }
+
+void ShaderProgram::bind() { StateCache::getInstance().useProgram(ProgramId); }
+
+void ShaderProgram::unbind() { StateCache::getInstance().useProgram(0); }
+
+///////////////////////////////////////////////////////////////////// REFLECTION
+
+const ShaderProgram::Handle ShaderProgram::NO_RESOURCE = ~Handle(0);
+
+// FNV-1a.
+static uint32_t hashName(std::string_view name) {
+  uint32_t hash = 2166136261u;
+  for (char c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+static const GLenum INTERFACES[] = {GL_PROGRAM_INPUT, GL_UNIFORM,
+                                    GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK};
+
+// Uniforms inside blocks and built-in inputs have no location of their own
+// and are left out; their blocks are listed instead.
+void ShaderProgram::reflect(Interface kind) {
+  const GLenum iface = INTERFACES[kind];
+  const bool is_block = kind == UNIFORM_BLOCK || kind == STORAGE_BLOCK;
+  GLint count = 0, max_length = 0;
+  glGetProgramInterfaceiv(ProgramId, iface, GL_ACTIVE_RESOURCES, &count);
+  glGetProgramInterfaceiv(ProgramId, iface, GL_MAX_NAME_LENGTH, &max_length);
+  std::vector<char> name(std::max(max_length, 1));
+  std::vector<ResourceInfo> &table = Resources[kind];
+  table.clear();
+  table.reserve(count);
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    glGetProgramResourceName(ProgramId, iface, i, max_length, &length,
+                             name.data());
+    ResourceInfo info;
+    info.Name.assign(name.data(), length);
+    if (info.Name.size() > 3 &&
+        info.Name.compare(info.Name.size() - 3, 3, "[0]") == 0) {
+      info.Name.resize(info.Name.size() - 3);
+    }
+    info.Hash = hashName(info.Name);
+    info.Index = static_cast<GLuint>(i);
+    if (is_block) {
+      const GLenum property = GL_BUFFER_BINDING;
+      glGetProgramResourceiv(ProgramId, iface, i, 1, &property, 1, nullptr,
+                             &info.Binding);
+      info.Location = -1;
+      info.Type = 0;
+      info.ArraySize = 1;
+    } else {
+      const GLenum properties[] = {GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE};
+      GLint values[3];
+      glGetProgramResourceiv(ProgramId, iface, i, 3, properties, 3, nullptr,
+                             values);
+      if (values[0] < 0) {
+        continue;
+      }
+      info.Location = values[0];
+      info.Type = static_cast<GLenum>(values[1]);
+      info.ArraySize = values[2];
+      info.Binding = -1;
+    }
+    table.push_back(std::move(info));
   }
+  std::sort(table.begin(), table.end(),
+            [](const ResourceInfo &a, const ResourceInfo &b) {
+              return a.Hash < b.Hash || (a.Hash == b.Hash && a.Name < b.Name);
+            });
 }
 
-void ShaderProgram::bind() { glUseProgram(ProgramId); }
+void ShaderProgram::bindBlocks(Interface kind,
+                               const std::vector<Binding> &bindings) {
+  for (const Binding &binding : bindings) {
+    const Handle handle = find(kind, binding.Name);
+    if (handle == NO_RESOURCE) {
+      std::cerr << "WARNING: " << (kind == UNIFORM_BLOCK ? "UBO " : "SSBO ")
+                << binding.Name << " not found." << std::endl;
+      continue;
+    }
+    ResourceInfo &block = Resources[kind][handle];
+    if (kind == UNIFORM_BLOCK) {
+      glUniformBlockBinding(ProgramId, block.Index, binding.Point);
+    } else {
+      glShaderStorageBlockBinding(ProgramId, block.Index, binding.Point);
+    }
+    block.Binding = static_cast<GLint>(binding.Point);
+  }
+}
 
-void ShaderProgram::unbind() { glUseProgram(0); }
+ShaderProgram::Handle ShaderProgram::find(Interface kind,
+                                          std::string_view name) const {
+  const std::vector<ResourceInfo> &table = Resources[kind];
+  const uint32_t hash = hashName(name);
+  auto it = std::lower_bound(
+      table.begin(), table.end(), hash,
+      [](const ResourceInfo &info, uint32_t h) { return info.Hash < h; });
+  for (; it != table.end() && it->Hash == hash; ++it) {
+    if (it->Name == name) {
+      return static_cast<Handle>(it - table.begin());
+    }
+  }
+  return NO_RESOURCE;
+}
+
+const ShaderProgram::ResourceInfo &ShaderProgram::get(Interface kind,
+                                                      Handle handle) const {
+  return Resources[kind][handle];
+}
+
+const std::vector<ShaderProgram::ResourceInfo> &
+ShaderProgram::getResources(Interface kind) const {
+  return Resources[kind];
+}
+
+bool ShaderProgram::isAttribute(std::string_view name) const {
+  return find(ATTRIBUTE, name) != NO_RESOURCE;
+}
+
+bool ShaderProgram::isUniform(std::string_view name) const {
+  return find(UNIFORM, name) != NO_RESOURCE;
+}
+
+bool ShaderProgram::isUniformBlock(std::string_view name) const {
+  return find(UNIFORM_BLOCK, name) != NO_RESOURCE;
+}
+
+bool ShaderProgram::isStorageBlock(std::string_view name) const {
+  return find(STORAGE_BLOCK, name) != NO_RESOURCE;
+}
+
+GLint ShaderProgram::getUniformLocation(std::string_view name) const {
+  const Handle handle = find(UNIFORM, name);
+  return handle == NO_RESOURCE ? -1 : Resources[UNIFORM][handle].Location;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 } // namespace mgl
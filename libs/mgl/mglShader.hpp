@@ -11,14 +11,34 @@
 
 #include <GL/glew.h>
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace mgl {
 
 class ShaderProgram;
+class AssetFile;
+
+// Names and values of the macros a program is compiled with.
+using ShaderDefines = std::map<std::string, std::string>;
 
 ////////////////////////////////////////////////////////////////// ShaderProgram
+//
+// Shader sources are preprocessed before they are compiled. An #include line
+// is replaced by the named file, found next to the file including it, and
+// the defines of the program are inserted after #version. A file is included
+// at most once per shader. #line directives keep compiler messages pointing
+// at the original lines, the compiler's source number being the file's
+// position in the list printed with them.
+//
+// Once linked, the program's active attributes, uniforms and blocks are read
+// back into a table per interface, sorted by name hash. Names are looked up
+// once, during setup, and resources are then reached by handle. Attribute
+// locations and block binding points given before create() are applied to
+// the linked program; uniforms need no declaring.
 
 class ShaderProgram {
 public:
@@ -29,39 +49,70 @@ public:
   };
   std::map<GLenum, GLuint> Shaders;
 
-  struct AttributeInfo {
-    GLuint index;
-  };
-  std::map<std::string, AttributeInfo> Attributes;
-
-  struct UniformInfo {
-    GLint index;
+  // An active resource of the linked program, as found by create(). Index is
+  // its resource index, Location that of an attribute or a uniform, -1 for
+  // blocks, and Binding the binding point of a block. Arrays are named
+  // without their "[0]".
+  struct ResourceInfo {
+    uint32_t Hash;
+    std::string Name;
+    GLuint Index;
+    GLint Location;
+    GLenum Type;
+    GLint ArraySize;
+    GLint Binding;
   };
-  std::map<std::string, UniformInfo> Uniforms;
-
-  struct UboInfo {
-    GLuint index;
-    GLuint binding_point;
-  };
-  std::map<std::string, UboInfo> Ubos;
+  enum Interface { ATTRIBUTE, UNIFORM, UNIFORM_BLOCK, STORAGE_BLOCK };
+  // Index of a resource in the table of its interface.
+  using Handle = uint32_t;
+  static const Handle NO_RESOURCE;
 
   ShaderProgram();
   ~ShaderProgram();
+  void setDefines(const ShaderDefines &defines);
+  const ShaderDefines &getDefines() const;
   void addShader(const GLenum shader_type, const std::string &filename);
+  void addShaderSource(const GLenum shader_type, const std::string &name,
+                       std::string_view source);
   void addAttribute(const std::string &name, const GLuint index);
-  bool isAttribute(const std::string &name);
   void addUniform(const std::string &name);
-  bool isUniform(const std::string &name);
   void addUniformBlock(const std::string &name, const GLuint binding_point);
-  bool isUniformBlock(const std::string &name);
+  void addStorageBlock(const std::string &name, const GLuint binding_point);
   void create();
+
+  Handle find(Interface kind, std::string_view name) const;
+  const ResourceInfo &get(Interface kind, Handle handle) const;
+  const std::vector<ResourceInfo> &getResources(Interface kind) const;
+  bool isAttribute(std::string_view name) const;
+  bool isUniform(std::string_view name) const;
+  bool isUniformBlock(std::string_view name) const;
+  bool isStorageBlock(std::string_view name) const;
+  // -1 if the program has no such active uniform.
+  GLint getUniformLocation(std::string_view name) const;
+  std::size_t getGpuBytes() const;
   void bind();
   void unbind();
 
 private:
-  const std::string read(const std::string &filename);
+  struct Binding {
+    std::string Name;
+    GLuint Point;
+  };
+  ShaderDefines Defines;
+  std::vector<Binding> AttributeBindings;
+  std::vector<std::string> ExpectedUniforms;
+  std::vector<Binding> UniformBlockBindings;
+  std::vector<Binding> StorageBlockBindings;
+  std::vector<ResourceInfo> Resources[4];
+  std::size_t GpuBytes;
+
+  std::string_view read(const std::string &filename, AssetFile &file);
+  void compile(const GLenum shader_type, const std::string &name,
+               std::string_view source);
   void checkCompilation(const GLuint shader_id, const std::string &filename);
   void checkLinkage();
+  void reflect(Interface kind);
+  void bindBlocks(Interface kind, const std::vector<Binding> &bindings);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
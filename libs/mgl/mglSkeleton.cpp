@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Skeletal Animation
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglSkeleton.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "./mglParallel.hpp"
+
+namespace mgl {
+
+/////////////////////////////////////////////////////////////////////// Skeleton
+
+const unsigned int Skeleton::NONE;
+const unsigned int Skeleton::MAX_BONES;
+
+template <typename T> static std::size_t bytes(const std::vector<T> &v) {
+  return sizeof(T) * v.capacity();
+}
+
+bool Skeleton::empty() const { return BoneJoints.empty(); }
+
+std::size_t Skeleton::getJointCount() const { return Parents.size(); }
+
+std::size_t Skeleton::getBoneCount() const { return BoneJoints.size(); }
+
+unsigned int Skeleton::findJoint(const std::string &name) const {
+  for (std::size_t i = 0; i < JointNames.size(); i++) {
+    if (JointNames[i] == name) {
+      return static_cast<unsigned int>(i);
+    }
+  }
+  return NONE;
+}
+
+void Skeleton::computePalette(const glm::mat4 *locals, glm::mat4 *globals,
+                              glm::mat4 *palette) const {
+  for (std::size_t j = 0; j < Parents.size(); j++) {
+    globals[j] =
+        Parents[j] == NONE ? locals[j] : globals[Parents[j]] * locals[j];
+  }
+  for (std::size_t b = 0; b < BoneJoints.size(); b++) {
+    palette[b] = globals[BoneJoints[b]] * InverseBindMatrices[b];
+  }
+}
+
+std::size_t Skeleton::getCpuBytes() const {
+  std::size_t names = bytes(JointNames);
+  for (const std::string &name : JointNames) {
+    names += name.capacity();
+  }
+  return names + bytes(Parents) + bytes(BindTransforms) + bytes(BoneJoints) +
+         bytes(InverseBindMatrices);
+}
+
+////////////////////////////////////////////////////////////////// AnimationClip
+
+// The last key at or before time, and how far time is towards the next one.
+static std::size_t findKey(const std::vector<float> &times, float time,
+                           float &blend) {
+  blend = 0.0f;
+  if (times.size() < 2 || time <= times.front()) {
+    return 0;
+  }
+  if (time >= times.back()) {
+    return times.size() - 1;
+  }
+  const std::size_t next =
+      std::upper_bound(times.begin(), times.end(), time) - times.begin();
+  const float span = times[next] - times[next - 1];
+  if (span > 0.0f) {
+    blend = (time - times[next - 1]) / span;
+  }
+  return next - 1;
+}
+
+static glm::vec3 sampleVec3(const std::vector<float> &times,
+                            const std::vector<glm::vec3> &values,
+                            float time) {
+  float blend;
+  const std::size_t k = findKey(times, time, blend);
+  return blend > 0.0f ? glm::mix(values[k], values[k + 1], blend) : values[k];
+}
+
+static glm::quat sampleQuat(const std::vector<float> &times,
+                            const std::vector<glm::quat> &values,
+                            float time) {
+  float blend;
+  const std::size_t k = findKey(times, time, blend);
+  return blend > 0.0f ? glm::slerp(values[k], values[k + 1], blend)
+                      : values[k];
+}
+
+void AnimationClip::sample(float time, const Skeleton &skeleton,
+                           glm::mat4 *locals) const {
+  std::copy(skeleton.BindTransforms.begin(), skeleton.BindTransforms.end(),
+            locals);
+  for (const AnimationChannel &channel : Channels) {
+    const glm::vec3 position =
+        sampleVec3(channel.PositionTimes, channel.Positions, time);
+    const glm::quat rotation =
+        sampleQuat(channel.RotationTimes, channel.Rotations, time);
+    const glm::vec3 scale =
+        sampleVec3(channel.ScaleTimes, channel.Scales, time);
+    // T * R * S, assembled without the two matrix products.
+    const glm::mat3 r = glm::mat3_cast(glm::normalize(rotation));
+    locals[channel.Joint] = glm::mat4(
+        glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f),
+        glm::vec4(r[2] * scale.z, 0.0f), glm::vec4(position, 1.0f));
+  }
+}
+
+std::size_t AnimationClip::getCpuBytes() const {
+  std::size_t total = Name.capacity() + bytes(Channels);
+  for (const AnimationChannel &channel : Channels) {
+    total += bytes(channel.PositionTimes) + bytes(channel.Positions) +
+             bytes(channel.RotationTimes) + bytes(channel.Rotations) +
+             bytes(channel.ScaleTimes) + bytes(channel.Scales);
+  }
+  return total;
+}
+
+/////////////////////////////////////////////////////////////////////// Animator
+
+const std::size_t Animator::MIN_THREAD_CHARACTERS;
+
+Animator::Animator() { Threads = 1; }
+
+void Animator::setThreads(unsigned int threads) { Threads = threads; }
+
+unsigned int Animator::addCharacter(const Skeleton *skeleton) {
+  Character character;
+  character.skeleton = skeleton;
+  character.clip = nullptr;
+  character.time = 0.0f;
+  character.paletteBase = static_cast<unsigned int>(Palettes.size());
+  character.jointBase = static_cast<unsigned int>(Locals.size());
+  Characters.push_back(character);
+  Palettes.resize(Palettes.size() + skeleton->getBoneCount(), glm::mat4(1.0f));
+  Locals.resize(Locals.size() + skeleton->getJointCount());
+  Globals.resize(Locals.size());
+  return static_cast<unsigned int>(Characters.size() - 1);
+}
+
+void Animator::setClip(unsigned int character, const AnimationClip *clip) {
+  if (character >= Characters.size()) {
+    std::cerr << "[ERROR] Invalid character " << character << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Characters[character].clip = clip;
+}
+
+void Animator::setTime(unsigned int character, float time) {
+  if (character >= Characters.size()) {
+    std::cerr << "[ERROR] Invalid character " << character << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Characters[character].time = time;
+}
+
+// Clips loop: times wrap around the duration of each character's clip.
+void Animator::advance(float seconds) {
+  for (Character &character : Characters) {
+    character.time += seconds;
+    if (character.clip && character.clip->Duration > 0.0f) {
+      character.time = std::fmod(character.time, character.clip->Duration);
+    }
+  }
+}
+
+// Characters without a clip are left in their bind pose.
+void Animator::updateCharacter(const Character &character) {
+  const Skeleton &skeleton = *character.skeleton;
+  glm::mat4 *locals = &Locals[character.jointBase];
+  if (character.clip) {
+    character.clip->sample(character.time, skeleton, locals);
+  } else {
+    std::copy(skeleton.BindTransforms.begin(), skeleton.BindTransforms.end(),
+              locals);
+  }
+  skeleton.computePalette(locals, &Globals[character.jointBase],
+                          &Palettes[character.paletteBase]);
+}
+
+// Runs every frame, so the characters are split over the threads of the job
+// pool rather than over threads started for the call.
+void Animator::update() {
+  const std::size_t n = Characters.size();
+  const std::size_t threads = std::max<std::size_t>(
+      std::min<std::size_t>(resolveThreads(Threads),
+                            n / MIN_THREAD_CHARACTERS),
+      1);
+  JobPool::getInstance().run(threads, [&](std::size_t r) {
+    for (std::size_t c = rangeBegin(n, threads, r);
+         c < rangeBegin(n, threads, r + 1); c++) {
+      updateCharacter(Characters[c]);
+    }
+  });
+}
+
+std::size_t Animator::size() const { return Characters.size(); }
+
+unsigned int Animator::getPaletteBase(unsigned int character) const {
+  return Characters[character].paletteBase;
+}
+
+const glm::mat4 *Animator::getPalette(unsigned int character) const {
+  return &Palettes[Characters[character].paletteBase];
+}
+
+const std::vector<glm::mat4> &Animator::getPalettes() const {
+  return Palettes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Skeletal Animation
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_SKELETON_HPP
+#define MGL_SKELETON_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+struct Skeleton;
+struct AnimationChannel;
+struct AnimationClip;
+class Animator;
+
+/////////////////////////////////////////////////////////////////////// Skeleton
+//
+// The joints of a skinned file: every node that is a bone or an ancestor of
+// one, parents first, so that global transforms are a single forward sweep.
+// Bones are the joints vertices are bound to, at most MAX_BONES so that an
+// index fits a byte; each has the inverse of its bind pose. The palette maps
+// bind pose positions of the file to posed ones, one matrix per bone.
+
+struct Skeleton {
+  static const unsigned int NONE = ~0u;
+  static const unsigned int MAX_BONES = 256;
+
+  std::vector<std::string> JointNames;
+  std::vector<unsigned int> Parents;
+  std::vector<glm::mat4> BindTransforms;
+  std::vector<unsigned int> BoneJoints;
+  std::vector<glm::mat4> InverseBindMatrices;
+
+  bool empty() const;
+  std::size_t getJointCount() const;
+  std::size_t getBoneCount() const;
+  unsigned int findJoint(const std::string &name) const;
+  // locals and globals hold a matrix per joint, palette one per bone.
+  void computePalette(const glm::mat4 *locals, glm::mat4 *globals,
+                      glm::mat4 *palette) const;
+  std::size_t getCpuBytes() const;
+};
+
+////////////////////////////////////////////////////////////////// AnimationClip
+//
+// Keyframes per animated joint, with times in seconds. Keys are interpolated
+// linearly, rotations by slerp, and held past the first and last ones. Joints
+// without a channel keep their bind transform.
+
+struct AnimationChannel {
+  unsigned int Joint;
+  std::vector<float> PositionTimes;
+  std::vector<glm::vec3> Positions;
+  std::vector<float> RotationTimes;
+  std::vector<glm::quat> Rotations;
+  std::vector<float> ScaleTimes;
+  std::vector<glm::vec3> Scales;
+};
+
+struct AnimationClip {
+  std::string Name;
+  float Duration = 0.0f;
+  std::vector<AnimationChannel> Channels;
+
+  // Fills a local transform per joint of the skeleton the clip was read with.
+  void sample(float time, const Skeleton &skeleton, glm::mat4 *locals) const;
+  std::size_t getCpuBytes() const;
+};
+
+/////////////////////////////////////////////////////////////////////// Animator
+//
+// Poses many characters at once. Each character plays a looping clip on a
+// skeleton, and update() samples every clip and computes every palette, with
+// characters split over the job pool. Palettes are stored back to back, in the
+// order characters were added, ready to be uploaded as a single buffer;
+// getPaletteBase() gives where a character's palette starts. All storage is
+// sized when characters are added, so updates do not allocate.
+
+class Animator {
+ public:
+  static const std::size_t MIN_THREAD_CHARACTERS = 16;
+
+  Animator();
+  // 0 uses one thread per hardware thread.
+  void setThreads(unsigned int threads);
+  unsigned int addCharacter(const Skeleton *skeleton);
+  void setClip(unsigned int character, const AnimationClip *clip);
+  void setTime(unsigned int character, float time);
+  void advance(float seconds);
+  void update();
+
+  std::size_t size() const;
+  unsigned int getPaletteBase(unsigned int character) const;
+  const glm::mat4 *getPalette(unsigned int character) const;
+  const std::vector<glm::mat4> &getPalettes() const;
+
+ private:
+  struct Character {
+    const Skeleton *skeleton;
+    const AnimationClip *clip;
+    float time;
+    unsigned int paletteBase;
+    unsigned int jointBase;
+  };
+  unsigned int Threads;
+  std::vector<Character> Characters;
+  std::vector<glm::mat4> Palettes;
+  std::vector<glm::mat4> Locals;
+  std::vector<glm::mat4> Globals;
+
+  void updateCharacter(const Character &character);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_SKELETON_HPP */
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex Skinning
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglSkinning.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "./mglApp.hpp"
+#include "./mglRing.hpp"
+
+namespace mgl {
+
+/////////////////////////////////////////////////////////////////// CPU SKINNING
+
+static const float WEIGHT_SCALE = 1.0f / 255.0f;
+
+static bool hasWeights(const glm::u8vec4 &w) {
+  return (w.x | w.y | w.z | w.w) != 0;
+}
+
+void skinVerticesScalar(const glm::mat4 *palette, const glm::vec3 *positions,
+                        const glm::vec3 *normals, const glm::u8vec4 *bones,
+                        const glm::u8vec4 *weights, std::size_t count,
+                        glm::vec3 *outPositions, glm::vec3 *outNormals) {
+  for (std::size_t v = 0; v < count; v++) {
+    const glm::u8vec4 &w = weights[v];
+    if (!hasWeights(w)) {
+      outPositions[v] = positions[v];
+      if (normals) {
+        outNormals[v] = normals[v];
+      }
+      continue;
+    }
+    glm::mat4 m(0.0f);
+    for (int k = 0; k < 4; k++) {
+      if (w[k] != 0) {
+        m += palette[bones[v][k]] * (w[k] * WEIGHT_SCALE);
+      }
+    }
+    outPositions[v] = glm::vec3(m * glm::vec4(positions[v], 1.0f));
+    if (normals) {
+      outNormals[v] =
+          glm::normalize(glm::vec3(m * glm::vec4(normals[v], 0.0f)));
+    }
+  }
+}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+void skinVertices(const glm::mat4 *palette, const glm::vec3 *positions,
+                  const glm::vec3 *normals, const glm::u8vec4 *bones,
+                  const glm::u8vec4 *weights, std::size_t count,
+                  glm::vec3 *outPositions, glm::vec3 *outNormals) {
+  for (std::size_t v = 0; v < count; v++) {
+    const glm::u8vec4 &w = weights[v];
+    if (!hasWeights(w)) {
+      outPositions[v] = positions[v];
+      if (normals) {
+        outNormals[v] = normals[v];
+      }
+      continue;
+    }
+    glm_vec4 c[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(),
+                     _mm_setzero_ps()};
+    for (int k = 0; k < 4; k++) {
+      if (w[k] == 0) {
+        continue;
+      }
+      const float *m = glm::value_ptr(palette[bones[v][k]]);
+      const glm_vec4 s = _mm_set1_ps(w[k] * WEIGHT_SCALE);
+      for (int i = 0; i < 4; i++) {
+        c[i] = _mm_add_ps(c[i], _mm_mul_ps(_mm_loadu_ps(m + 4 * i), s));
+      }
+    }
+    // Results go through a 4-float store; the outputs are vec3 arrays.
+    alignas(16) float out[4];
+    const glm::vec3 &p = positions[v];
+    glm_vec4 r = _mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(p.x)), c[3]);
+    r = _mm_add_ps(r, _mm_mul_ps(c[1], _mm_set1_ps(p.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c[2], _mm_set1_ps(p.z)));
+    _mm_store_ps(out, r);
+    outPositions[v] = glm::vec3(out[0], out[1], out[2]);
+    if (normals) {
+      const glm::vec3 &n = normals[v];
+      r = _mm_mul_ps(c[0], _mm_set1_ps(n.x));
+      r = _mm_add_ps(r, _mm_mul_ps(c[1], _mm_set1_ps(n.y)));
+      r = _mm_add_ps(r, _mm_mul_ps(c[2], _mm_set1_ps(n.z)));
+      _mm_store_ps(out, r);
+      outNormals[v] = glm::normalize(glm::vec3(out[0], out[1], out[2]));
+    }
+  }
+}
+
+#else
+
+void skinVertices(const glm::mat4 *palette, const glm::vec3 *positions,
+                  const glm::vec3 *normals, const glm::u8vec4 *bones,
+                  const glm::u8vec4 *weights, std::size_t count,
+                  glm::vec3 *outPositions, glm::vec3 *outNormals) {
+  skinVerticesScalar(palette, positions, normals, bones, weights, count,
+                     outPositions, outNormals);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////// PaletteBuffer
+
+PaletteBuffer::PaletteBuffer(GLuint bindingpoint) {
+  BindingPoint = bindingpoint;
+  Bytes = 0;
+}
+
+// Ring bytes taken by the last upload.
+std::size_t PaletteBuffer::getGpuBytes() const { return Bytes; }
+
+void PaletteBuffer::upload(const std::vector<glm::mat4> &palettes) {
+  if (palettes.empty()) {
+    return;
+  }
+  UploadRing &ring = Engine::getInstance().getUploadRing();
+  Bytes = sizeof(glm::mat4) * palettes.size();
+  const UploadRing::Region region =
+      ring.write(palettes.data(), static_cast<GLsizeiptr>(Bytes));
+  ring.bindRange(GL_SHADER_STORAGE_BUFFER, BindingPoint, region);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
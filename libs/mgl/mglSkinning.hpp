@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex Skinning
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_SKINNING_HPP
+#define MGL_SKINNING_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <glm/ext/vector_uint4_sized.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+class PaletteBuffer;
+
+/////////////////////////////////////////////////////////////////// CPU SKINNING
+//
+// Linear blend skinning for contexts that cannot skin on the GPU, such as a
+// software rasterizer. Each vertex blends up to four palette matrices by its
+// unorm8 weights, which sum to 255, and transforms its position and normal by
+// the result; vertices without weights are copied. With SIMD enabled
+// (GLM_FORCE_INTRINSICS) the blend and the transform run in SSE registers.
+// Normals are renormalized, and assume palettes without non-uniform scale.
+// Calls share no state, so characters can be skinned on separate threads.
+// skinVerticesScalar() is the plain glm version, always built, which the SIMD
+// one is measured and checked against.
+
+void skinVertices(const glm::mat4 *palette, const glm::vec3 *positions,
+                  const glm::vec3 *normals, const glm::u8vec4 *bones,
+                  const glm::u8vec4 *weights, std::size_t count,
+                  glm::vec3 *outPositions, glm::vec3 *outNormals);
+void skinVerticesScalar(const glm::mat4 *palette, const glm::vec3 *positions,
+                        const glm::vec3 *normals, const glm::u8vec4 *bones,
+                        const glm::u8vec4 *weights, std::size_t count,
+                        glm::vec3 *outPositions, glm::vec3 *outNormals);
+
+////////////////////////////////////////////////////////////////// PaletteBuffer
+//
+// Palettes of every character for vertex shader skinning, bound to a fixed
+// shader storage binding point. Shaders read the matrices of a draw from the
+// PaletteBase uniform on. As palettes change every frame, each upload writes
+// them into a fresh region of the engine's upload ring and binds that range,
+// so upload() must be called in every frame that draws skinned meshes.
+
+class PaletteBuffer {
+ public:
+  explicit PaletteBuffer(GLuint bindingpoint);
+
+  void upload(const std::vector<glm::mat4> &palettes);
+  std::size_t getGpuBytes() const;
+
+ private:
+  GLuint BindingPoint;
+  std::size_t Bytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_SKINNING_HPP */
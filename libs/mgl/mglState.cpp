@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// OpenGL State Cache
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglState.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// StateCache
+
+const GLuint StateCache::MAX_INDEXED_BINDINGS;
+const GLuint StateCache::UNKNOWN;
+
+StateCache::StateCache() { invalidate(); }
+
+// Each thread has its own cache, as each thread has its own current context.
+StateCache &StateCache::getInstance() {
+  static thread_local StateCache instance;
+  return instance;
+}
+
+int StateCache::bufferTarget(GLenum target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    return ARRAY_BUFFER;
+  case GL_UNIFORM_BUFFER:
+    return UNIFORM_BUFFER;
+  case GL_SHADER_STORAGE_BUFFER:
+    return SHADER_STORAGE_BUFFER;
+  case GL_COPY_READ_BUFFER:
+    return COPY_READ_BUFFER;
+  case GL_COPY_WRITE_BUFFER:
+    return COPY_WRITE_BUFFER;
+  case GL_DRAW_INDIRECT_BUFFER:
+    return DRAW_INDIRECT_BUFFER;
+  case GL_PIXEL_UNPACK_BUFFER:
+    return PIXEL_UNPACK_BUFFER;
+  default:
+    return -1;
+  }
+}
+
+int StateCache::capability(GLenum cap) {
+  switch (cap) {
+  case GL_DEPTH_TEST:
+    return DEPTH_TEST;
+  case GL_CULL_FACE:
+    return CULL_FACE;
+  case GL_BLEND:
+    return BLEND;
+  case GL_SCISSOR_TEST:
+    return SCISSOR_TEST;
+  case GL_STENCIL_TEST:
+    return STENCIL_TEST;
+  case GL_POLYGON_OFFSET_FILL:
+    return POLYGON_OFFSET_FILL;
+  default:
+    return -1;
+  }
+}
+
+bool StateCache::changes(GLuint &cached, GLuint value) {
+  if (cached == value) {
+    Counters.Avoided++;
+    return false;
+  }
+  cached = value;
+  Counters.Issued++;
+  return true;
+}
+
+void StateCache::useProgram(GLuint program) {
+  if (changes(Program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void StateCache::bindVertexArray(GLuint vao) {
+  if (changes(VertexArray, vao)) {
+    glBindVertexArray(vao);
+  }
+}
+
+void StateCache::bindBuffer(GLenum target, GLuint buffer) {
+  const int t = bufferTarget(target);
+  if (t >= 0 && !changes(Buffers[t], buffer)) {
+    return;
+  }
+  if (t < 0) {
+    Counters.Issued++;
+  }
+  glBindBuffer(target, buffer);
+}
+
+void StateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  GLuint *indexed = nullptr;
+  if (index < MAX_INDEXED_BINDINGS) {
+    if (target == GL_UNIFORM_BUFFER) {
+      indexed = &IndexedUniformBuffers[index];
+    } else if (target == GL_SHADER_STORAGE_BUFFER) {
+      indexed = &IndexedStorageBuffers[index];
+    }
+  }
+  if (indexed && !changes(*indexed, buffer)) {
+    return;
+  }
+  if (!indexed) {
+    Counters.Issued++;
+  }
+  glBindBufferBase(target, index, buffer);
+  // glBindBufferBase also binds the buffer to the generic binding point.
+  const int t = bufferTarget(target);
+  if (t >= 0) {
+    Buffers[t] = buffer;
+  }
+}
+
+// Ranges are not cached: the call is always issued, and the indexed binding
+// is forgotten so that a later bindBufferBase of the same buffer is not
+// mistaken for a redundant one.
+void StateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                 GLintptr offset, GLsizeiptr size) {
+  if (index < MAX_INDEXED_BINDINGS) {
+    if (target == GL_UNIFORM_BUFFER) {
+      IndexedUniformBuffers[index] = UNKNOWN;
+    } else if (target == GL_SHADER_STORAGE_BUFFER) {
+      IndexedStorageBuffers[index] = UNKNOWN;
+    }
+  }
+  Counters.Issued++;
+  glBindBufferRange(target, index, buffer, offset, size);
+  const int t = bufferTarget(target);
+  if (t >= 0) {
+    Buffers[t] = buffer;
+  }
+}
+
+void StateCache::setCapability(GLenum cap, GLuint value) {
+  const int c = capability(cap);
+  if (c >= 0 && !changes(Capabilities[c], value)) {
+    return;
+  }
+  if (c < 0) {
+    Counters.Issued++;
+  }
+  if (value) {
+    glEnable(cap);
+  } else {
+    glDisable(cap);
+  }
+}
+
+void StateCache::enable(GLenum cap) { setCapability(cap, 1); }
+
+void StateCache::disable(GLenum cap) { setCapability(cap, 0); }
+
+void StateCache::deleteProgram(GLuint program) {
+  // A program in use is only flagged for deletion, so release it first.
+  if (Program == program) {
+    useProgram(0);
+  }
+  glDeleteProgram(program);
+}
+
+void StateCache::deleteVertexArray(GLuint vao) {
+  glDeleteVertexArrays(1, &vao);
+  if (VertexArray == vao) {
+    VertexArray = 0;
+  }
+}
+
+void StateCache::deleteBuffer(GLuint buffer) {
+  glDeleteBuffers(1, &buffer);
+  for (GLuint &bound : Buffers) {
+    bound = bound == buffer ? 0 : bound;
+  }
+  for (GLuint i = 0; i < MAX_INDEXED_BINDINGS; i++) {
+    if (IndexedUniformBuffers[i] == buffer) {
+      IndexedUniformBuffers[i] = 0;
+    }
+    if (IndexedStorageBuffers[i] == buffer) {
+      IndexedStorageBuffers[i] = 0;
+    }
+  }
+}
+
+void StateCache::invalidate() {
+  Program = UNKNOWN;
+  VertexArray = UNKNOWN;
+  for (GLuint &buffer : Buffers) {
+    buffer = UNKNOWN;
+  }
+  for (GLuint i = 0; i < MAX_INDEXED_BINDINGS; i++) {
+    IndexedUniformBuffers[i] = UNKNOWN;
+    IndexedStorageBuffers[i] = UNKNOWN;
+  }
+  for (GLuint &cap : Capabilities) {
+    cap = UNKNOWN;
+  }
+}
+
+const StateCache::Stats &StateCache::getStats() const { return Counters; }
+
+void StateCache::resetStats() { Counters = Stats(); }
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// OpenGL State Cache
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_STATE_HPP
+#define MGL_STATE_HPP
+
+#include <GL/glew.h>
+
+namespace mgl {
+
+class StateCache;
+
+///////////////////////////////////////////////////////////////////// StateCache
+//
+// Shadows the bound program, vertex array, buffer bindings and capability
+// flags of the current context, and drops calls that would not change them.
+// All mgl code binds through this cache; code issuing raw binds must call
+// invalidate() afterwards. Element array bindings belong to the vertex array
+// and are not cached. There is one cache per thread.
+
+class StateCache {
+ public:
+  static const GLuint MAX_INDEXED_BINDINGS = 16;
+
+  struct Stats {
+    unsigned long long Issued = 0;
+    unsigned long long Avoided = 0;
+  };
+
+  static StateCache &getInstance();
+
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vao);
+  void bindBuffer(GLenum target, GLuint buffer);
+  void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+  void bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                       GLintptr offset, GLsizeiptr size);
+  void enable(GLenum cap);
+  void disable(GLenum cap);
+
+  // Deleting a bound object implicitly unbinds it in GL.
+  void deleteProgram(GLuint program);
+  void deleteVertexArray(GLuint vao);
+  void deleteBuffer(GLuint buffer);
+
+  void invalidate();
+  const Stats &getStats() const;
+  void resetStats();
+
+ private:
+  enum BufferTarget {
+    ARRAY_BUFFER,
+    UNIFORM_BUFFER,
+    SHADER_STORAGE_BUFFER,
+    COPY_READ_BUFFER,
+    COPY_WRITE_BUFFER,
+    DRAW_INDIRECT_BUFFER,
+    PIXEL_UNPACK_BUFFER,
+    BUFFER_TARGETS
+  };
+  enum Capability {
+    DEPTH_TEST,
+    CULL_FACE,
+    BLEND,
+    SCISSOR_TEST,
+    STENCIL_TEST,
+    POLYGON_OFFSET_FILL,
+    CAPABILITIES
+  };
+  static const GLuint UNKNOWN = ~0u;
+
+  GLuint Program;
+  GLuint VertexArray;
+  GLuint Buffers[BUFFER_TARGETS];
+  GLuint IndexedUniformBuffers[MAX_INDEXED_BINDINGS];
+  GLuint IndexedStorageBuffers[MAX_INDEXED_BINDINGS];
+  GLuint Capabilities[CAPABILITIES];
+  Stats Counters;
+
+  StateCache();
+  static int bufferTarget(GLenum target);
+  static int capability(GLenum cap);
+  bool changes(GLuint &cached, GLuint value);
+  void setCapability(GLenum cap, GLuint value);
+
+ public:
+  StateCache(StateCache const &) = delete;
+  void operator=(StateCache const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_STATE_HPP */
@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Tangent Space Generation
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglTangents.hpp"
+
+#include <algorithm>
+#include <memory>
+
+#include "./mglParallel.hpp"
+
+namespace mgl {
+
+/////////////////////////////////////////////////////////////// TangentGenerator
+
+const std::size_t TangentGenerator::MIN_THREAD_TRIANGLES;
+
+// Per vertex: angle weighted sums of the tangent and bitangent directions.
+static const std::size_t SUMS = 6;
+
+// Without C++20 fetch_add on floats, a compare-exchange loop.
+static void atomicAdd(std::atomic<float> &sum, float value) {
+  float current = sum.load(std::memory_order_relaxed);
+  while (!sum.compare_exchange_weak(current, current + value,
+                                    std::memory_order_relaxed)) {
+  }
+}
+
+static bool notZero(const glm::vec3 &v) { return glm::dot(v, v) > 0.0f; }
+
+static glm::vec3 projectOnPlane(const glm::vec3 &v, const glm::vec3 &n) {
+  const glm::vec3 projected = v - glm::dot(n, v) * n;
+  return notZero(projected) ? glm::normalize(projected) : projected;
+}
+
+TangentGenerator::TangentGenerator() {
+  Threads = 0;
+  Positions = nullptr;
+  Normals = nullptr;
+  Texcoords = nullptr;
+  VertexCount = 0;
+  TriangleCount = 0;
+}
+
+void TangentGenerator::setThreads(unsigned int threads) { Threads = threads; }
+
+void TangentGenerator::setVertices(const glm::vec3 *positions,
+                                   const glm::vec3 *normals,
+                                   const glm::vec2 *texcoords,
+                                   std::size_t count) {
+  Positions = positions;
+  Normals = normals;
+  Texcoords = texcoords;
+  VertexCount = count;
+}
+
+void TangentGenerator::addTriangles(const unsigned int *indices,
+                                    std::size_t count,
+                                    unsigned int baseVertex) {
+  if (count >= 3) {
+    Ranges.push_back({indices, TriangleCount, count / 3, baseVertex});
+    TriangleCount += count / 3;
+  }
+}
+
+void TangentGenerator::accumulate(std::atomic<float> *sums, std::size_t begin,
+                                  std::size_t end) const {
+  auto range = std::upper_bound(Ranges.begin(), Ranges.end(), begin,
+                                [](std::size_t t, const Triangles &triangles) {
+                                  return t < triangles.first;
+                                });
+  for (--range; begin < end; ++range) {
+    const std::size_t last = std::min(end, range->first + range->count);
+    for (std::size_t t = begin; t < last; t++) {
+      const unsigned int *triangle = range->indices + (t - range->first) * 3;
+      unsigned int v[3];
+      for (int k = 0; k < 3; k++) {
+        v[k] = range->baseVertex + triangle[k];
+      }
+      const glm::vec3 &p0 = Positions[v[0]];
+      const glm::vec3 d1 = Positions[v[1]] - p0;
+      const glm::vec3 d2 = Positions[v[2]] - p0;
+      if (!notZero(glm::cross(d1, d2))) {
+        continue;
+      }
+      // dP/du and dP/dv, up to the signed UV area.
+      const glm::vec2 t21 = Texcoords[v[1]] - Texcoords[v[0]];
+      const glm::vec2 t31 = Texcoords[v[2]] - Texcoords[v[0]];
+      const float area = t21.x * t31.y - t21.y * t31.x;
+      glm::vec3 os = t31.y * d1 - t21.y * d2;
+      glm::vec3 ot = -t31.x * d1 + t21.x * d2;
+      if (area != 0.0f) {
+        const float sign = area > 0.0f ? 1.0f : -1.0f;
+        os = notZero(os) ? sign * glm::normalize(os) : os;
+        ot = notZero(ot) ? sign * glm::normalize(ot) : ot;
+      }
+      for (int k = 0; k < 3; k++) {
+        const glm::vec3 &n = Normals[v[k]];
+        const glm::vec3 &p = Positions[v[k]];
+        const glm::vec3 e1 = projectOnPlane(Positions[v[(k + 2) % 3]] - p, n);
+        const glm::vec3 e2 = projectOnPlane(Positions[v[(k + 1) % 3]] - p, n);
+        const float angle =
+            glm::acos(glm::clamp(glm::dot(e1, e2), -1.0f, 1.0f));
+        const glm::vec3 s = angle * projectOnPlane(os, n);
+        const glm::vec3 b = angle * projectOnPlane(ot, n);
+        std::atomic<float> *sum = sums + v[k] * SUMS;
+        for (int c = 0; c < 3; c++) {
+          atomicAdd(sum[c], s[c]);
+          atomicAdd(sum[3 + c], b[c]);
+        }
+      }
+    }
+    begin = last;
+  }
+}
+
+void TangentGenerator::generate(glm::vec4 *tangents, glm::vec3 *bitangents) {
+  const std::size_t n = VertexCount;
+  const std::size_t threads = std::max<std::size_t>(
+      std::min<std::size_t>(resolveThreads(Threads),
+                            TriangleCount / MIN_THREAD_TRIANGLES),
+      1);
+  std::unique_ptr<std::atomic<float>[]> sums(
+      new std::atomic<float>[n * SUMS]);
+  runParallel(threads, [&](std::size_t r) {
+    for (std::size_t i = rangeBegin(n * SUMS, threads, r);
+         i < rangeBegin(n * SUMS, threads, r + 1); i++) {
+      sums[i].store(0.0f, std::memory_order_relaxed);
+    }
+  });
+  if (TriangleCount > 0) {
+    runParallel(threads, [&](std::size_t r) {
+      accumulate(sums.get(), rangeBegin(TriangleCount, threads, r),
+                 rangeBegin(TriangleCount, threads, r + 1));
+    });
+  }
+
+  // Vertices no triangle reached get any frame orthogonal to their normal.
+  runParallel(threads, [&](std::size_t r) {
+    for (std::size_t v = rangeBegin(n, threads, r);
+         v < rangeBegin(n, threads, r + 1); v++) {
+      const std::atomic<float> *sum = &sums[v * SUMS];
+      const glm::vec3 os(sum[0].load(std::memory_order_relaxed),
+                         sum[1].load(std::memory_order_relaxed),
+                         sum[2].load(std::memory_order_relaxed));
+      const glm::vec3 ot(sum[3].load(std::memory_order_relaxed),
+                         sum[4].load(std::memory_order_relaxed),
+                         sum[5].load(std::memory_order_relaxed));
+      const glm::vec3 &normal = Normals[v];
+      glm::vec3 tangent = projectOnPlane(os, normal);
+      if (!notZero(tangent)) {
+        const glm::vec3 axis = glm::abs(normal.x) < 0.9f
+                                   ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                   : glm::vec3(0.0f, 1.0f, 0.0f);
+        tangent = projectOnPlane(axis, normal);
+      }
+      const glm::vec3 cross = glm::cross(normal, tangent);
+      const float sign = glm::dot(cross, ot) < 0.0f ? -1.0f : 1.0f;
+      tangents[v] = glm::vec4(tangent, sign);
+      if (bitangents) {
+        bitangents[v] = sign * cross;
+      }
+    }
+  });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
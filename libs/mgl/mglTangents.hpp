@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Tangent Space Generation
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_TANGENTS_HPP
+#define MGL_TANGENTS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+class TangentGenerator;
+
+/////////////////////////////////////////////////////////////// TangentGenerator
+//
+// Per-vertex tangent frames as computed by MikkTSpace: each triangle's UV
+// derivatives are projected onto the tangent plane of each corner's normal
+// and weighted by the corner angle. Triangles are processed in parallel and
+// add their corners into the vertices without locks. Tangents are unit length
+// and carry the bitangent sign in w, so B = w * cross(N, T).
+//
+// MikkTSpace also splits vertices whose corners disagree in orientation;
+// vertices are never split here, which gives the same frames on meshes that
+// are already split at UV seams and mirror lines.
+
+class TangentGenerator {
+ public:
+  static const std::size_t MIN_THREAD_TRIANGLES = 1 << 14;
+
+  TangentGenerator();
+  // 0 uses one thread per hardware thread.
+  void setThreads(unsigned int threads);
+  void setVertices(const glm::vec3 *positions, const glm::vec3 *normals,
+                   const glm::vec2 *texcoords, std::size_t count);
+  // Indices are relative to baseVertex, as drawn by glDrawElementsBaseVertex.
+  void addTriangles(const unsigned int *indices, std::size_t count,
+                    unsigned int baseVertex);
+  // Bitangents are optional.
+  void generate(glm::vec4 *tangents, glm::vec3 *bitangents = nullptr);
+
+ private:
+  struct Triangles {
+    const unsigned int *indices;
+    std::size_t first;
+    std::size_t count;
+    unsigned int baseVertex;
+  };
+  unsigned int Threads;
+  const glm::vec3 *Positions;
+  const glm::vec3 *Normals;
+  const glm::vec2 *Texcoords;
+  std::size_t VertexCount;
+  std::vector<Triangles> Ranges;
+  std::size_t TriangleCount;
+
+  void accumulate(std::atomic<float> *sums, std::size_t begin,
+                  std::size_t end) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_TANGENTS_HPP */
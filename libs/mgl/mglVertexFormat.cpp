@@ -0,0 +1,23 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex Format Descriptors
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglVertexFormat.hpp"
+
+#include <atomic>
+
+namespace mgl {
+
+/////////////////////////////////////////////////////////////////// VertexLayout
+
+unsigned int nextVertexLayoutId() {
+  static std::atomic<unsigned int> next(0);
+  return next++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
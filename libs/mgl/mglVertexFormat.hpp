@@ -0,0 +1,322 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex Format Descriptors
+//
+// Copyright (c)2022-24 by Carlos Martinho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_VERTEX_FORMAT_HPP
+#define MGL_VERTEX_FORMAT_HPP
+
+#include <GL/glew.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "./mglConventions.hpp"
+#include "./mglShader.hpp"
+
+namespace mgl {
+
+struct Half;
+struct VertexSource;
+struct VertexLayout;
+template <typename T> struct ComponentType;
+template <typename... Attributes> struct VertexFormat;
+
+/////////////////////////////////////////////////////////////////////// Semantic
+//
+// A semantic fixes both the attribute location and the shader input name, so
+// that any vertex format binds to any program set up with the same semantics.
+
+enum class Semantic : GLuint {
+  POSITION = 1,
+  NORMAL = 2,
+  TEXCOORD = 3,
+  TANGENT = 4,
+  BITANGENT = 5,
+  COLOR = 6,
+  BONES = 7,
+  WEIGHTS = 8
+};
+
+const GLuint SEMANTICS = 9;
+
+// Number of components a semantic is provided with by the loader. Tangents
+// carry the bitangent sign in w. Bones and weights come packed, as bytes.
+constexpr GLint sourceComponents(Semantic semantic) {
+  switch (semantic) {
+  case Semantic::TEXCOORD:
+    return 2;
+  case Semantic::POSITION:
+  case Semantic::NORMAL:
+  case Semantic::BITANGENT:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+inline const char *attributeName(Semantic semantic) {
+  switch (semantic) {
+  case Semantic::POSITION:
+    return POSITION_ATTRIBUTE;
+  case Semantic::NORMAL:
+    return NORMAL_ATTRIBUTE;
+  case Semantic::TEXCOORD:
+    return TEXCOORD_ATTRIBUTE;
+  case Semantic::TANGENT:
+    return TANGENT_ATTRIBUTE;
+  case Semantic::BITANGENT:
+    return BITANGENT_ATTRIBUTE;
+  case Semantic::BONES:
+    return BONES_ATTRIBUTE;
+  case Semantic::WEIGHTS:
+    return WEIGHTS_ATTRIBUTE;
+  default:
+    return COLOR_ATTRIBUTE;
+  }
+}
+
+////////////////////////////////////////////////////////////////// ComponentType
+
+struct Half {
+  uint16_t bits;
+};
+
+template <> struct ComponentType<float> {
+  static constexpr GLenum VALUE = GL_FLOAT;
+};
+template <> struct ComponentType<Half> {
+  static constexpr GLenum VALUE = GL_HALF_FLOAT;
+};
+template <> struct ComponentType<int8_t> {
+  static constexpr GLenum VALUE = GL_BYTE;
+};
+template <> struct ComponentType<uint8_t> {
+  static constexpr GLenum VALUE = GL_UNSIGNED_BYTE;
+};
+template <> struct ComponentType<int16_t> {
+  static constexpr GLenum VALUE = GL_SHORT;
+};
+template <> struct ComponentType<uint16_t> {
+  static constexpr GLenum VALUE = GL_UNSIGNED_SHORT;
+};
+template <> struct ComponentType<int32_t> {
+  static constexpr GLenum VALUE = GL_INT;
+};
+template <> struct ComponentType<uint32_t> {
+  static constexpr GLenum VALUE = GL_UNSIGNED_INT;
+};
+
+// Normalized integers map [-1, 1] (signed) or [0, 1] (unsigned) onto the full
+// integer range; integers that are not normalized reach the shader as ints.
+template <typename T, bool Normalized> T convertComponent(float value) {
+  if constexpr (std::is_same<T, float>::value) {
+    return value;
+  } else if constexpr (std::is_same<T, Half>::value) {
+    return {glm::packHalf1x16(value)};
+  } else if constexpr (Normalized && std::is_signed<T>::value) {
+    const float max = static_cast<float>(std::numeric_limits<T>::max());
+    return static_cast<T>(std::lround(glm::clamp(value, -1.0f, 1.0f) * max));
+  } else if constexpr (Normalized) {
+    const float max = static_cast<float>(std::numeric_limits<T>::max());
+    return static_cast<T>(std::lround(glm::clamp(value, 0.0f, 1.0f) * max));
+  } else {
+    return static_cast<T>(value);
+  }
+}
+
+/////////////////////////////////////////////////////////////////// VertexSource
+//
+// Non-interleaved float streams indexed by semantic, as produced by the mesh
+// loader. Missing streams are null and are uploaded as zeros. Streams already
+// quantized to four bytes per vertex, such as bone indices and weights, are
+// set packed and copied as they are into 4 x 8-bit attributes.
+
+struct VertexSource {
+  const float *Streams[SEMANTICS] = {};
+  const uint8_t *Packed[SEMANTICS] = {};
+
+  void set(Semantic semantic, const float *data) {
+    Streams[static_cast<GLuint>(semantic)] = data;
+  }
+  void setPacked(Semantic semantic, const uint8_t *data) {
+    Packed[static_cast<GLuint>(semantic)] = data;
+  }
+};
+
+////////////////////////////////////////////////////////////////////// Attribute
+
+template <Semantic S, typename T, GLint N, bool Normalized = false>
+struct Attribute {
+  static_assert(N >= 1 && N <= 4, "attributes have 1 to 4 components");
+
+  static constexpr Semantic SEMANTIC = S;
+  static constexpr GLuint LOCATION = static_cast<GLuint>(S);
+  static constexpr GLenum TYPE = ComponentType<T>::VALUE;
+  static constexpr GLint COUNT = N;
+  static constexpr GLboolean NORMALIZED = Normalized ? GL_TRUE : GL_FALSE;
+  static constexpr bool INTEGER = std::is_integral<T>::value && !Normalized;
+  static constexpr GLuint SIZE = sizeof(T) * N;
+
+  // Direct state access: describe the attribute on a vertex buffer binding.
+  static void format(GLuint vao, GLuint binding, GLuint offset) {
+    if constexpr (INTEGER) {
+      glVertexArrayAttribIFormat(vao, LOCATION, N, TYPE, offset);
+    } else {
+      glVertexArrayAttribFormat(vao, LOCATION, N, TYPE, NORMALIZED, offset);
+    }
+    glVertexArrayAttribBinding(vao, LOCATION, binding);
+    glEnableVertexArrayAttrib(vao, LOCATION);
+  }
+
+  // Bind-to-edit: describe the attribute on the bound array buffer.
+  static void pointer(GLsizei stride, GLuint offset) {
+    const void *start = reinterpret_cast<const void *>(uintptr_t(offset));
+    if constexpr (INTEGER) {
+      glVertexAttribIPointer(LOCATION, N, TYPE, stride, start);
+    } else {
+      glVertexAttribPointer(LOCATION, N, TYPE, NORMALIZED, stride, start);
+    }
+    glEnableVertexAttribArray(LOCATION);
+  }
+
+  // Components the source does not provide are zero.
+  static void pack(const VertexSource &source, std::size_t count,
+                   unsigned char *out, GLsizei stride) {
+    constexpr GLint C = sourceComponents(S);
+    if constexpr (sizeof(T) == 1 && N == 4) {
+      const uint8_t *packed = source.Packed[LOCATION];
+      if (packed) {
+        for (std::size_t v = 0; v < count; v++) {
+          std::memcpy(out + v * stride, packed + v * 4, 4);
+        }
+        return;
+      }
+    }
+    const float *in = source.Streams[LOCATION];
+    T value[N];
+    if (!in) {
+      std::memset(value, 0, SIZE);
+      for (std::size_t v = 0; v < count; v++) {
+        std::memcpy(out + v * stride, value, SIZE);
+      }
+      return;
+    }
+    for (std::size_t v = 0; v < count; v++) {
+      for (GLint c = 0; c < N; c++) {
+        const float component = c < C ? in[v * C + c] : 0.0f;
+        value[c] = convertComponent<T, Normalized>(component);
+      }
+      std::memcpy(out + v * stride, value, SIZE);
+    }
+  }
+};
+
+/////////////////////////////////////////////////////////////////// VertexLayout
+//
+// Type-erased view of a VertexFormat, so meshes can pick a format at runtime.
+// Formats share an Id only if they are the same type.
+
+struct VertexLayout {
+  unsigned int Id;
+  GLsizei Stride;
+  void (*setupVertexArray)(GLuint vao, GLuint buffer);
+  void (*setupBoundVertexArray)();
+  void (*pack)(const VertexSource &source, std::size_t count, void *out);
+  void (*bindAttributes)(ShaderProgram &shader);
+};
+
+unsigned int nextVertexLayoutId();
+
+/////////////////////////////////////////////////////////////////// VertexFormat
+//
+// A single interleaved vertex buffer described at compile time. The stride,
+// offsets and per-attribute GL calls are resolved by the compiler, so setting
+// up a vertex array or packing vertices has no per-attribute branching.
+
+template <typename... Attributes> struct VertexFormat {
+  static_assert(sizeof...(Attributes) > 0, "formats have at least 1 attribute");
+
+  static constexpr GLsizei STRIDE = (0 + ... + Attributes::SIZE);
+  static_assert(STRIDE % 4 == 0, "vertex strides are a multiple of 4 bytes");
+
+  static constexpr GLuint offset(std::size_t index) {
+    const GLuint sizes[] = {Attributes::SIZE...};
+    GLuint result = 0;
+    for (std::size_t i = 0; i < index; i++) {
+      result += sizes[i];
+    }
+    return result;
+  }
+
+  static constexpr bool distinctSemantics() {
+    const GLuint locations[] = {Attributes::LOCATION...};
+    for (std::size_t i = 0; i < sizeof...(Attributes); i++) {
+      for (std::size_t j = i + 1; j < sizeof...(Attributes); j++) {
+        if (locations[i] == locations[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  static_assert(distinctSemantics(), "a semantic appears only once per format");
+
+  static void setupVertexArray(GLuint vao, GLuint buffer) {
+    glVertexArrayVertexBuffer(vao, 0, buffer, 0, STRIDE);
+    formatAll(vao, std::index_sequence_for<Attributes...>());
+  }
+
+  static void setupBoundVertexArray() {
+    pointerAll(std::index_sequence_for<Attributes...>());
+  }
+
+  static void pack(const VertexSource &source, std::size_t count, void *out) {
+    packAll(source, count, static_cast<unsigned char *>(out),
+            std::index_sequence_for<Attributes...>());
+  }
+
+  static void bindAttributes(ShaderProgram &shader) {
+    (shader.addAttribute(attributeName(Attributes::SEMANTIC),
+                         Attributes::LOCATION),
+     ...);
+  }
+
+  static const VertexLayout &layout() {
+    static const VertexLayout instance = {nextVertexLayoutId(), STRIDE,
+                                          &setupVertexArray,
+                                          &setupBoundVertexArray, &pack,
+                                          &bindAttributes};
+    return instance;
+  }
+
+ private:
+  template <std::size_t... I>
+  static void formatAll(GLuint vao, std::index_sequence<I...>) {
+    (Attributes::format(vao, 0, offset(I)), ...);
+  }
+  template <std::size_t... I>
+  static void pointerAll(std::index_sequence<I...>) {
+    (Attributes::pointer(STRIDE, offset(I)), ...);
+  }
+  template <std::size_t... I>
+  static void packAll(const VertexSource &source, std::size_t count,
+                      unsigned char *out, std::index_sequence<I...>) {
+    (Attributes::pack(source, count, out + offset(I), STRIDE), ...);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_VERTEX_FORMAT_HPP */
@@ -0,0 +1,310 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Offline asset baking
+//
+// Copyright (c) 2023-24 by Carlos Martinho
+//
+// Walks an asset directory and runs every model through the mgl::Mesh load
+// pipeline (welding, vertex cache ordering, quantization, levels of detail
+// and bounds), then writes each as a baked .mglb file that Mesh::load()
+// copies straight into its buffers. A JSON manifest lists every asset with
+// its statistics. Needs no OpenGL context. Optionally, the baked files and
+// the other files of the asset directory, such as textures, are packed into
+// a single asset pack.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "mgl/mgl.hpp"
+#include "mgl/mglParallel.hpp"
+
+namespace fs = std::filesystem;
+
+//////////////////////////////////////////////////////////////////////// OPTIONS
+
+struct Options {
+  fs::path input;
+  fs::path output;
+  fs::path manifest;
+  fs::path pack;
+  unsigned int threads = 0;
+  bool weld = true;
+  float weldEpsilon = mgl::Mesh::DEFAULT_WELD_EPSILON;
+  bool compact = false;
+  bool tangents = false;
+  unsigned int lods = 3;
+};
+
+static void usage() {
+  std::cerr
+      << "Usage: mgl-bake [options] <input directory> <output directory>\n"
+         "  --threads N    assets baked at once (default: one per core)\n"
+         "  --weld EPS     weld vertices on a grid of EPS (default 1e-6)\n"
+         "  --no-weld      keep vertices as loaded\n"
+         "  --compact      quantize to CompactVertex where it fits\n"
+         "  --tangents     generate packed tangents\n"
+         "  --lods N       levels of detail after the first (default 3)\n"
+         "  --manifest F   manifest path (default: <output>/manifest.json)\n"
+         "  --pack F       also pack the baked and other files into F\n";
+  exit(EXIT_FAILURE);
+}
+
+static Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--threads" && has_value) {
+      options.threads = std::stoul(argv[++i]);
+    } else if (arg == "--weld" && has_value) {
+      options.weldEpsilon = std::stof(argv[++i]);
+    } else if (arg == "--no-weld") {
+      options.weld = false;
+    } else if (arg == "--compact") {
+      options.compact = true;
+    } else if (arg == "--tangents") {
+      options.tangents = true;
+    } else if (arg == "--lods" && has_value) {
+      options.lods = std::stoul(argv[++i]);
+    } else if (arg == "--manifest" && has_value) {
+      options.manifest = argv[++i];
+    } else if (arg == "--pack" && has_value) {
+      options.pack = argv[++i];
+    } else if (arg.compare(0, 2, "--") == 0) {
+      usage();
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 2) {
+    usage();
+  }
+  options.input = paths[0];
+  options.output = paths[1];
+  if (options.manifest.empty()) {
+    options.manifest = options.output / "manifest.json";
+  }
+  return options;
+}
+
+/////////////////////////////////////////////////////////////////////// BAKING
+
+struct AssetStats {
+  std::string source;
+  std::string output;
+  std::size_t vertices = 0;
+  std::vector<std::size_t> triangles;
+  std::size_t drawRecords = 0;
+  std::size_t materials = 0;
+  std::size_t bones = 0;
+  std::size_t clips = 0;
+  std::size_t morphTargets = 0;
+  float cacheMissRatio = 0.0f;
+  mgl::Bounds bounds;
+  std::uintmax_t sourceBytes = 0;
+  std::uintmax_t bakedBytes = 0;
+  double milliseconds = 0.0;
+};
+
+// Assets are the files Assimp reads, minus side files such as OBJ material
+// libraries, which are left with the other files.
+static void findFiles(const fs::path &root, std::vector<fs::path> &assets,
+                      std::vector<fs::path> &others) {
+  Assimp::Importer importer;
+  for (const fs::directory_entry &entry :
+       fs::recursive_directory_iterator(root)) {
+    const std::string extension = entry.path().extension().string();
+    if (!entry.is_regular_file() || extension == mgl::PACK_EXTENSION) {
+      continue;
+    }
+    if (extension != ".mtl" && extension != mgl::BAKED_EXTENSION &&
+        importer.IsExtensionSupported(extension)) {
+      assets.push_back(entry.path());
+    } else {
+      others.push_back(entry.path());
+    }
+  }
+  std::sort(assets.begin(), assets.end());
+}
+
+// CompactVertex has no tangents or bones, so meshes with them keep their
+// float layout.
+static AssetStats bake(const Options &options, const fs::path &source) {
+  const auto start = std::chrono::steady_clock::now();
+  fs::path output = options.output / fs::relative(source, options.input);
+  output.replace_extension(mgl::BAKED_EXTENSION);
+  fs::create_directories(output.parent_path());
+
+  mgl::Mesh mesh;
+  mesh.joinIdenticalVertices();
+  if (options.weld) {
+    mesh.weldVertices(options.weldEpsilon);
+  }
+  if (options.tangents) {
+    mesh.generateTangents(true);
+  }
+  mesh.optimizeVertexCache();
+  mesh.generateLods(options.lods);
+  mesh.load(source.string());
+  if (options.compact && !mesh.hasBones() && !mesh.hasTangentsAndBitangents() &&
+      !options.tangents) {
+    mesh.setVertexLayout(mgl::CompactVertex::layout());
+  }
+  mesh.save(output.string());
+
+  AssetStats stats;
+  stats.source = source.generic_string();
+  stats.output = output.generic_string();
+  stats.vertices = mesh.getVertexCount();
+  for (unsigned int level = 0; level < mesh.getLodCount(); level++) {
+    stats.triangles.push_back(mesh.getTriangleCount(level));
+  }
+  stats.drawRecords = mesh.getDrawRecords().size();
+  stats.materials = mesh.getMaterials().size();
+  stats.bones = mesh.getSkeleton().getBoneCount();
+  stats.clips = mesh.getAnimationClips().size();
+  stats.morphTargets = mesh.getMorphTargets().getTargetCount();
+  stats.cacheMissRatio = mesh.getCacheMissRatio();
+  stats.bounds = mesh.getBounds();
+  stats.sourceBytes = fs::file_size(source);
+  stats.bakedBytes = fs::file_size(output);
+  stats.milliseconds = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  return stats;
+}
+
+///////////////////////////////////////////////////////////////////// MANIFEST
+
+static std::string quote(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+static std::ostream &operator<<(std::ostream &out, const glm::vec3 &v) {
+  return out << "[" << v.x << ", " << v.y << ", " << v.z << "]";
+}
+
+static void writeManifest(const fs::path &path,
+                          const std::vector<AssetStats> &assets) {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "[ERROR] Cannot write " << path.string() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  out << "{\n  \"version\": " << mgl::BAKED_VERSION << ",\n  \"assets\": [";
+  for (std::size_t i = 0; i < assets.size(); i++) {
+    const AssetStats &a = assets[i];
+    out << (i ? ",\n" : "\n") << "    {\n"
+        << "      \"source\": " << quote(a.source) << ",\n"
+        << "      \"output\": " << quote(a.output) << ",\n"
+        << "      \"vertices\": " << a.vertices << ",\n"
+        << "      \"triangles\": [";
+    for (std::size_t l = 0; l < a.triangles.size(); l++) {
+      out << (l ? ", " : "") << a.triangles[l];
+    }
+    out << "],\n"
+        << "      \"drawRecords\": " << a.drawRecords << ",\n"
+        << "      \"materials\": " << a.materials << ",\n"
+        << "      \"bones\": " << a.bones << ",\n"
+        << "      \"clips\": " << a.clips << ",\n"
+        << "      \"morphTargets\": " << a.morphTargets << ",\n"
+        << "      \"cacheMissRatio\": " << a.cacheMissRatio << ",\n"
+        << "      \"bounds\": {\"min\": " << a.bounds.min
+        << ", \"max\": " << a.bounds.max << ", \"radius\": " << a.bounds.radius
+        << "},\n"
+        << "      \"sourceBytes\": " << a.sourceBytes << ",\n"
+        << "      \"bakedBytes\": " << a.bakedBytes << ",\n"
+        << "      \"milliseconds\": " << a.milliseconds << "\n"
+        << "    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+/////////////////////////////////////////////////////////////////////// PACKING
+
+// Names are relative to the directories, as the files would be looked up
+// with the pack mounted under the asset directory.
+static std::size_t writePack(const Options &options,
+                             const std::vector<AssetStats> &assets,
+                             const std::vector<fs::path> &others) {
+  mgl::PackWriter writer;
+  for (const AssetStats &asset : assets) {
+    writer.add(fs::relative(asset.output, options.output).generic_string(),
+               asset.output);
+  }
+  for (const fs::path &other : others) {
+    writer.add(fs::relative(other, options.input).generic_string(),
+               other.string());
+  }
+  return writer.write(options.pack.string());
+}
+
+/////////////////////////////////////////////////////////////////////// MAIN
+
+// Assets are handed out one at a time, as their sizes vary widely. Each is
+// loaded on a single thread; the parallelism is across files.
+int main(int argc, char *argv[]) {
+  const Options options = parseOptions(argc, argv);
+  if (!fs::is_directory(options.input)) {
+    std::cerr << "[ERROR] " << options.input.string()
+              << " is not a directory" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::vector<fs::path> sources, others;
+  findFiles(options.input, sources, others);
+  std::vector<AssetStats> assets(sources.size());
+  std::atomic<std::size_t> next(0);
+  std::mutex console;
+  const std::size_t threads = std::max<std::size_t>(
+      std::min<std::size_t>(mgl::resolveThreads(options.threads),
+                            sources.size()),
+      1);
+  try {
+    mgl::runParallel(threads, [&](std::size_t) {
+      for (std::size_t i = next++; i < sources.size(); i = next++) {
+        assets[i] = bake(options, sources[i]);
+        std::lock_guard<std::mutex> lock(console);
+        std::cout << "Baked " << assets[i].source << " -> "
+                  << assets[i].output << " [" << assets[i].vertices
+                  << " vertices, " << assets[i].triangles.front()
+                  << " triangles, " << assets[i].milliseconds << " ms]"
+                  << std::endl;
+      }
+    });
+  } catch (const mgl::LoadError &error) {
+    std::cerr << "[ERROR] " << error.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  fs::create_directories(options.output);
+  writeManifest(options.manifest, assets);
+  std::cout << "Baked " << assets.size() << " asset(s), manifest "
+            << options.manifest.string() << std::endl;
+  if (!options.pack.empty()) {
+    const std::size_t bytes = writePack(options, assets, others);
+    std::cout << "Packed " << assets.size() + others.size() << " file(s) in "
+              << options.pack.string() << " [" << bytes << " bytes]"
+              << std::endl;
+  }
+  exit(EXIT_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
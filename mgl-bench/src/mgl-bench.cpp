@@ -0,0 +1,341 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Animation benchmark
+//
+// Copyright (c) 2023-24 by Carlos Martinho
+//
+// Times character animation on generated data, so that it needs no assets:
+// Animator::update() posing many characters, from one thread up to every
+// thread of the job pool, CPU skinning of many meshes with the SIMD
+// skinVertices() against the plain skinVerticesScalar(), and the upload of
+// the posed palettes through the engine's upload ring. The upload runs in a
+// hidden window's context and is skipped if OpenGL 4.4 is not available; it
+// times the writes into the mapped ring and the fence of each frame, not the
+// GPU reading them. Every timing is the mean over a number of frames.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "mgl/mgl.hpp"
+#include "mgl/mglParallel.hpp"
+
+//////////////////////////////////////////////////////////////////////// OPTIONS
+
+struct Options {
+  std::size_t characters = 1000;
+  std::size_t joints = 64;
+  std::size_t keys = 30;
+  std::size_t meshes = 100;
+  std::size_t vertices = 5000;
+  std::size_t frames = 100;
+  unsigned int threads = 0;
+};
+
+static void usage() {
+  std::cerr << "Usage: mgl-bench [options]\n"
+               "  --characters N animated characters (default 1000)\n"
+               "  --joints N     joints per skeleton, all bones (default 64)\n"
+               "  --keys N       keys per channel (default 30)\n"
+               "  --meshes N     skinned meshes (default 100)\n"
+               "  --vertices N   vertices per mesh (default 5000)\n"
+               "  --frames N     frames per timing (default 100)\n"
+               "  --threads N    most threads posing (default: job pool)\n";
+  exit(EXIT_FAILURE);
+}
+
+static Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    const std::size_t value = std::stoul(argv[++i]);
+    if (arg == "--characters") {
+      options.characters = value;
+    } else if (arg == "--joints") {
+      options.joints = value;
+    } else if (arg == "--keys") {
+      options.keys = value;
+    } else if (arg == "--meshes") {
+      options.meshes = value;
+    } else if (arg == "--vertices") {
+      options.vertices = value;
+    } else if (arg == "--frames") {
+      options.frames = value;
+    } else if (arg == "--threads") {
+      options.threads = static_cast<unsigned int>(value);
+    } else {
+      usage();
+    }
+  }
+  if (options.joints == 0 || options.joints > mgl::Skeleton::MAX_BONES ||
+      options.keys == 0 || options.frames == 0) {
+    usage();
+  }
+  return options;
+}
+
+////////////////////////////////////////////////////////////////////////// SCENE
+
+// A balanced binary tree of joints, parents first, each one unit above its
+// parent and bound to vertices.
+static mgl::Skeleton makeSkeleton(std::size_t joints) {
+  mgl::Skeleton skeleton;
+  std::vector<glm::mat4> globals(joints);
+  for (std::size_t j = 0; j < joints; j++) {
+    const unsigned int parent =
+        j == 0 ? mgl::Skeleton::NONE : static_cast<unsigned int>((j - 1) / 2);
+    const glm::mat4 local =
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    globals[j] = j == 0 ? local : globals[parent] * local;
+    skeleton.JointNames.push_back("joint" + std::to_string(j));
+    skeleton.Parents.push_back(parent);
+    skeleton.BindTransforms.push_back(local);
+    skeleton.BoneJoints.push_back(static_cast<unsigned int>(j));
+    skeleton.InverseBindMatrices.push_back(glm::inverse(globals[j]));
+  }
+  return skeleton;
+}
+
+// Every joint swings about its own axis for a second.
+static mgl::AnimationClip makeClip(std::size_t joints, std::size_t keys) {
+  mgl::AnimationClip clip;
+  clip.Name = "swing";
+  clip.Duration = 1.0f;
+  for (std::size_t j = 0; j < joints; j++) {
+    mgl::AnimationChannel channel;
+    channel.Joint = static_cast<unsigned int>(j);
+    channel.PositionTimes.push_back(0.0f);
+    channel.Positions.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+    channel.ScaleTimes.push_back(0.0f);
+    channel.Scales.push_back(glm::vec3(1.0f));
+    const glm::vec3 axis = glm::normalize(
+        glm::vec3(std::sin(float(j)), 1.0f, std::cos(float(j))));
+    for (std::size_t k = 0; k < keys; k++) {
+      const float t = keys > 1 ? float(k) / float(keys - 1) : 0.0f;
+      channel.RotationTimes.push_back(t * clip.Duration);
+      channel.Rotations.push_back(glm::angleAxis(
+          0.5f * std::sin(glm::two_pi<float>() * t), axis));
+    }
+    clip.Channels.push_back(channel);
+  }
+  return clip;
+}
+
+struct SkinnedMesh {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::u8vec4> bones;
+  std::vector<glm::u8vec4> weights;
+};
+
+// Vertices blend four random bones, with weights summing to 255.
+static SkinnedMesh makeMesh(std::size_t vertices, std::size_t joints,
+                            std::mt19937 &random) {
+  std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+  std::uniform_int_distribution<unsigned int> bone(
+      0, static_cast<unsigned int>(joints - 1));
+  std::uniform_int_distribution<unsigned int> weight(1, 63);
+  SkinnedMesh mesh;
+  for (std::size_t v = 0; v < vertices; v++) {
+    mesh.positions.push_back(glm::vec3(coordinate(random), coordinate(random),
+                                       coordinate(random)));
+    mesh.normals.push_back(glm::normalize(glm::vec3(
+        coordinate(random), coordinate(random), coordinate(random) + 2.0f)));
+    glm::u8vec4 b, w;
+    unsigned int sum = 0;
+    for (int k = 0; k < 4; k++) {
+      b[k] = static_cast<glm::u8>(bone(random));
+      w[k] = static_cast<glm::u8>(k < 3 ? weight(random) : 255 - sum);
+      sum += w[k];
+    }
+    mesh.bones.push_back(b);
+    mesh.weights.push_back(w);
+  }
+  return mesh;
+}
+
+///////////////////////////////////////////////////////////////////////// TIMING
+
+// Milliseconds per call of body, over the given number of frames.
+template <typename Body>
+static double timeFrames(std::size_t frames, const Body &body) {
+  body();
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t f = 0; f < frames; f++) {
+    body();
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         frames;
+}
+
+static void benchAnimator(const Options &options,
+                          const mgl::Skeleton &skeleton,
+                          const mgl::AnimationClip &clip) {
+  const unsigned int most =
+      options.threads ? options.threads
+                      : mgl::JobPool::getInstance().getThreadCount();
+  std::cout << "Animator::update, " << options.characters << " characters of "
+            << options.joints << " joints (job pool of "
+            << mgl::JobPool::getInstance().getThreadCount() << " threads)"
+            << std::endl;
+  double single = 0.0;
+  for (unsigned int threads = 1; threads <= most; threads++) {
+    mgl::Animator animator;
+    animator.setThreads(threads);
+    for (std::size_t c = 0; c < options.characters; c++) {
+      const unsigned int character = animator.addCharacter(&skeleton);
+      animator.setClip(character, &clip);
+      animator.setTime(character, float(c) / float(options.characters));
+    }
+    const double ms = timeFrames(options.frames, [&]() {
+      animator.advance(1.0f / 60.0f);
+      animator.update();
+    });
+    if (threads == 1) {
+      single = ms;
+    }
+    std::cout << "  " << std::setw(3) << threads << " thread(s) "
+              << std::setw(10) << ms << " ms/frame  x" << single / ms
+              << std::endl;
+  }
+}
+
+// The scalar results are the reference the SIMD ones are compared with.
+static void benchSkinning(const Options &options,
+                          const mgl::Skeleton &skeleton,
+                          const mgl::AnimationClip &clip) {
+  mgl::Animator animator;
+  animator.addCharacter(&skeleton);
+  animator.setClip(0, &clip);
+  animator.setTime(0, 0.25f);
+  animator.update();
+  const glm::mat4 *palette = animator.getPalette(0);
+
+  std::mt19937 random(2024);
+  std::vector<SkinnedMesh> meshes;
+  for (std::size_t m = 0; m < options.meshes; m++) {
+    meshes.push_back(makeMesh(options.vertices, options.joints, random));
+  }
+  std::vector<glm::vec3> positions(options.vertices), normals(options.vertices);
+  std::vector<glm::vec3> expected(options.vertices);
+  float error = 0.0f;
+
+  std::cout << "skinVertices, " << options.meshes << " meshes of "
+            << options.vertices << " vertices" << std::endl;
+  const double scalar = timeFrames(options.frames, [&]() {
+    for (const SkinnedMesh &mesh : meshes) {
+      mgl::skinVerticesScalar(palette, mesh.positions.data(),
+                              mesh.normals.data(), mesh.bones.data(),
+                              mesh.weights.data(), options.vertices,
+                              positions.data(), normals.data());
+    }
+  });
+  const double simd = timeFrames(options.frames, [&]() {
+    for (const SkinnedMesh &mesh : meshes) {
+      mgl::skinVertices(palette, mesh.positions.data(), mesh.normals.data(),
+                        mesh.bones.data(), mesh.weights.data(),
+                        options.vertices, positions.data(), normals.data());
+    }
+  });
+  for (const SkinnedMesh &mesh : meshes) {
+    mgl::skinVerticesScalar(palette, mesh.positions.data(), nullptr,
+                            mesh.bones.data(), mesh.weights.data(),
+                            options.vertices, expected.data(), nullptr);
+    mgl::skinVertices(palette, mesh.positions.data(), nullptr,
+                      mesh.bones.data(), mesh.weights.data(), options.vertices,
+                      positions.data(), nullptr);
+    for (std::size_t v = 0; v < options.vertices; v++) {
+      error = std::max(error, glm::length(positions[v] - expected[v]));
+    }
+  }
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+  const char *variant = "SSE";
+#else
+  const char *variant = "SIMD off";
+#endif
+  std::cout << "  scalar   " << std::setw(10) << scalar << " ms/frame\n"
+            << "  " << std::left << std::setw(8) << variant << std::right
+            << " " << std::setw(10) << simd << " ms/frame  x" << scalar / simd
+            << "\n  largest position difference " << error << std::endl;
+}
+
+// The ring holds three frames of palettes, so that it does not wait on the
+// GPU more than an application sized for its frames in flight would.
+static void benchPalettes(const Options &options,
+                          const mgl::Skeleton &skeleton,
+                          const mgl::AnimationClip &clip) {
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window =
+      glfwInit() ? glfwCreateWindow(1, 1, "mgl-bench", nullptr, nullptr)
+                 : nullptr;
+  if (window) {
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+  }
+  if (!window || glewInit() != GLEW_OK || !mgl::UploadRing::isSupported()) {
+    std::cout << "PaletteBuffer::upload skipped, no OpenGL 4.4 context"
+              << std::endl;
+    glfwTerminate();
+    return;
+  }
+  glGetError();
+
+  mgl::Animator animator;
+  for (std::size_t c = 0; c < options.characters; c++) {
+    const unsigned int character = animator.addCharacter(&skeleton);
+    animator.setClip(character, &clip);
+    animator.setTime(character, float(c) / float(options.characters));
+  }
+  animator.update();
+  const std::vector<glm::mat4> &palettes = animator.getPalettes();
+  const std::size_t bytes = sizeof(glm::mat4) * palettes.size();
+  mgl::Engine::getInstance().setUploadRing(
+      static_cast<GLsizeiptr>(3 * bytes));
+  mgl::UploadRing &ring = mgl::Engine::getInstance().getUploadRing();
+  mgl::PaletteBuffer buffer(0);
+
+  std::cout << "PaletteBuffer::upload, " << palettes.size() << " matrices ["
+            << bytes << " bytes] per frame" << std::endl;
+  const double ms = timeFrames(options.frames, [&]() {
+    buffer.upload(palettes);
+    ring.endFrame();
+  });
+  std::cout << "  ring     " << std::setw(10) << ms << " ms/frame  "
+            << double(bytes) / ms / 1.0e6 << " GB/s" << std::endl;
+  glFinish();
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+/////////////////////////////////////////////////////////////////////////// MAIN
+
+int main(int argc, char *argv[]) {
+  const Options options = parseOptions(argc, argv);
+  const mgl::Skeleton skeleton = makeSkeleton(options.joints);
+  const mgl::AnimationClip clip = makeClip(options.joints, options.keys);
+  std::cout << std::fixed << std::setprecision(3);
+  benchAnimator(options, skeleton, clip);
+  if (options.meshes > 0 && options.vertices > 0) {
+    benchSkinning(options, skeleton, clip);
+  }
+  if (options.characters > 0) {
+    benchPalettes(options, skeleton, clip);
+  }
+  exit(EXIT_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////